@@ -0,0 +1,117 @@
+#include "batch_planner.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "common.hpp"
+
+namespace raven {
+
+namespace detail {
+
+// minimizers are kept as two 64-bit values and copied once while sorted
+double constexpr kIndexBytesPerMinimizer = 32;
+
+// minhash keeps about a quarter of the minimizers of a read
+double constexpr kMinhashFraction = 0.25;
+
+// overlaps of a mapped base with buffers used while chaining
+std::uint64_t constexpr kMappingBytesPerBase = 4;
+
+// at most a quarter of the budget goes to mapping batches
+std::uint64_t constexpr kMappingShare = 4;
+
+// smallest batch to keep passes over the reads from exploding
+std::uint64_t constexpr kMinBatchBases = 1ULL << 24;
+
+// value of the limit in path, 0 if there is none
+std::uint64_t ReadLimit(const std::string& path) {
+  std::ifstream is(path);
+  std::string value;
+  if (!(is >> value) || value == "max") {
+    return 0;
+  }
+  return std::strtoull(value.c_str(), nullptr, 10);
+}
+
+// cgroup v2 path of this process, empty if there is none
+std::string CgroupPath() {
+  std::ifstream is("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line.compare(0, 3, "0::") == 0) {
+      return line.substr(3);
+    }
+  }
+  return "";
+}
+
+}  // namespace detail
+
+namespace util {
+
+std::uint64_t AvailableMemory() {
+  std::uint64_t dst = 0;
+  auto num_pages = sysconf(_SC_PHYS_PAGES);
+  auto page_len = sysconf(_SC_PAGE_SIZE);
+  if (num_pages > 0 && page_len > 0) {
+    dst = static_cast<std::uint64_t>(num_pages) * page_len;
+  }
+
+  auto cgroup = detail::CgroupPath();
+  for (const auto& it : {
+           "/sys/fs/cgroup" + (cgroup == "/" ? "" : cgroup) + "/memory.max",
+           std::string("/sys/fs/cgroup/memory.max"),
+           std::string("/sys/fs/cgroup/memory/memory.limit_in_bytes")}) {
+    auto limit = detail::ReadLimit(it);
+    if (limit > 0 && (dst == 0 || limit < dst)) {
+      dst = limit;
+    }
+  }
+  return dst;
+}
+
+}  // namespace util
+
+BatchPlanner::BatchPlanner(std::uint64_t budget, std::uint32_t window_len)
+    : budget_(budget),
+      index_bytes_per_base_(
+          detail::kIndexBytesPerMinimizer * 2 / (window_len + 1)) {}
+
+std::uint64_t BatchPlanner::IndexBases(
+    std::uint64_t resident_bytes, bool minhash) const {
+  if (budget_ == 0) {
+    return minhash ? constants::kSeqsBatchLim : constants::kOvlpBatchLim;
+  }
+  auto reserved = resident_bytes +
+      2 * MappingBases() * detail::kMappingBytesPerBase;
+  if (reserved >= budget_) {
+    return detail::kMinBatchBases;
+  }
+  auto bytes_per_base = index_bytes_per_base_ *
+      (minhash ? detail::kMinhashFraction : 1.);
+  return std::max(detail::kMinBatchBases, static_cast<std::uint64_t>(
+      (budget_ - reserved) / bytes_per_base));
+}
+
+std::uint64_t BatchPlanner::MappingBases() const {
+  if (budget_ == 0) {
+    return constants::kOvlpBatchLim;
+  }
+  return std::max(detail::kMinBatchBases, std::min<std::uint64_t>(
+      constants::kOvlpBatchLim,
+      budget_ / detail::kMappingShare / (2 * detail::kMappingBytesPerBase)));
+}
+
+std::uint64_t BatchPlanner::StreamBases() const {
+  if (budget_ == 0) {
+    return constants::kSeqsBatchLim;
+  }
+  return IndexBases(0, true) / 2;
+}
+
+}  // namespace raven
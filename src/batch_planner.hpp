@@ -0,0 +1,50 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_BATCH_PLANNER_HPP_
+#define RAVEN_BATCH_PLANNER_HPP_
+
+#include <cstdint>
+
+namespace raven {
+
+namespace util {
+
+// bytes of physical memory capped by the memory limit of the cgroup of this
+// process (v2 or v1), 0 if unknown
+std::uint64_t AvailableMemory();
+
+}  // namespace util
+
+// chooses batch sizes in bases from a memory budget, estimated from read
+// lengths only: a minimization batch is bounded by its minimizer index and a
+// mapping batch by the overlaps found for it (two are held by the pipeline);
+// without a budget the fixed limits of constants are used
+class BatchPlanner {
+ public:
+  // budget in bytes, 0 for the fixed limits
+  explicit BatchPlanner(std::uint64_t budget = 0,
+                        std::uint32_t window_len = 5);
+
+  std::uint64_t budget() const {
+    return budget_;
+  }
+
+  // bases to minimize at once while resident_bytes are taken by reads and
+  // other data; a minhash index keeps a fraction of the minimizers
+  std::uint64_t IndexBases(std::uint64_t resident_bytes, bool minhash) const;
+
+  // bases to map at once
+  std::uint64_t MappingBases() const;
+
+  // bases to parse at once when reads are streamed, half of the budget left
+  // to the index is kept for reads parsed by then
+  std::uint64_t StreamBases() const;
+
+ private:
+  std::uint64_t budget_;
+  double index_bytes_per_base_;
+};
+
+}  // namespace raven
+
+#endif  // RAVEN_BATCH_PLANNER_HPP_
@@ -1,4 +1,16 @@
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "cereal/archives/binary.hpp"
 
 #include "common.hpp"
 
@@ -6,40 +18,96 @@ namespace raven {
 
 namespace util {
 
-std::unique_ptr<bioparser::Parser<biosoup::Sequence>> CreateParser(
-    const std::string& path) {
-  auto is_suffix = [](const std::string& s, const std::string& suff) {
-    return s.size() < suff.size()
-               ? false
-               : s.compare(s.size() - suff.size(), suff.size(), suff) == 0;
-  };
+namespace detail {
 
-  if (is_suffix(path, ".fasta") || is_suffix(path, ".fa") ||
-      is_suffix(path, ".fasta.gz") || is_suffix(path, ".fa.gz")) {
-    try {
-      return bioparser::Parser<biosoup::Sequence>::Create<
-          bioparser::FastaParser>(path);
-    } catch (const std::invalid_argument& exception) {
-      std::cerr << exception.what() << std::endl;
-      return nullptr;
+// runs load(i) for every input on up to num_threads loader threads, not on the
+// thread pool as compressed inputs are inflated there
+void ForEachInput(std::size_t num_inputs,
+                  std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+                  const std::function<void(std::size_t)>& load) {
+  std::atomic<std::size_t> next{0};
+  auto loader = [&] () -> void {
+    for (std::size_t i; (i = next++) < num_inputs;) {
+      load(i);
     }
+  };
+
+  std::vector<std::future<void>> futures;
+  auto num_loaders = std::min<std::size_t>(
+      num_inputs, thread_pool ? thread_pool->num_threads() : 1);
+  for (std::size_t i = 1; i < num_loaders; ++i) {
+    futures.emplace_back(std::async(std::launch::async, loader));
+  }
+  loader();
+  for (auto& it : futures) {
+    it.get();
   }
-  if (is_suffix(path, ".fastq") || is_suffix(path, ".fq") ||
-      is_suffix(path, ".fastq.gz") || is_suffix(path, ".fq.gz")) {
-    try {
-      return bioparser::Parser<biosoup::Sequence>::Create<
-          bioparser::FastqParser>(path);
-    } catch (const std::invalid_argument& exception) {
-      std::cerr << exception.what() << std::endl;
-      return nullptr;
+}
+
+}  // namespace detail
+
+SequenceStream::SequenceStream(
+    std::unique_ptr<SequenceParser> parser, bool prefetch,
+    bool defer_qualities, std::uint64_t batch_bytes)
+    : parser_(std::move(parser)),
+      prefetch_(prefetch),
+      defer_qualities_(defer_qualities),
+      batch_bytes_(batch_bytes),
+      next_() {
+  if (parser_ == nullptr) {
+    throw std::invalid_argument(
+        "[raven::SequenceStream] error: missing sequence parser");
+  }
+  if (prefetch_) {
+    next_ = std::async(std::launch::async, [this]() { return ParseBatch(); });
+  }
+}
+
+SequenceStream::~SequenceStream() {
+  if (next_.valid()) {  // prefetch task holds this
+    next_.wait();
+  }
+}
+
+PackedSequences SequenceStream::Next() {
+  auto dst = next_.valid() ? next_.get() : ParseBatch();
+  if (!dst.empty() && prefetch_) {
+    next_ = std::async(std::launch::async, [this]() { return ParseBatch(); });
+  }
+  return dst;
+}
+
+PackedSequences SequenceStream::ParseBatch() {
+  PackedSequences dst;
+
+  std::uint64_t bytes = 0;
+  while (bytes < batch_bytes_) {
+    auto chunk = parser_->Parse(constants::kParseChunkLim);
+    if (chunk.empty()) {
+      break;
+    }
+    for (const auto& it : chunk) {
+      PackedSequence bases(it.data, it.data_len);  // straight from the view
+      if (bases.size() < constants::kMinSequenceLen) {
+        continue;
+      }
+      bytes += bases.size();
+
+      std::unique_ptr<biosoup::Sequence> header(new biosoup::Sequence());
+      header->name.assign(it.name, it.name_len);
+      double mean_quality = 0.;
+      if (it.quality) {
+        mean_quality = MeanQuality(it.quality, it.quality_len);
+        if (!defer_qualities_) {
+          header->quality = StripLineBreaks(it.quality, it.quality_len);
+        }
+      }
+      dst.Append(std::move(header), std::move(bases), mean_quality,
+                 SequenceOrigin{it.input, 0, it.offset}, it.quality != nullptr);
     }
   }
 
-  std::cerr << "[raven::CreateParser] error: file " << path
-            << " has unsupported format extension (valid extensions: .fasta, "
-            << ".fasta.gz, .fa, .fa.gz, .fastq, .fastq.gz, .fq, .fq.gz)"
-            << std::endl;
-  return nullptr;
+  return dst;
 }
 
 std::vector<std::unique_ptr<biosoup::Sequence>> MergeSequences(
@@ -66,10 +134,27 @@ std::vector<std::unique_ptr<biosoup::Sequence>>& NormalizeSeqIds(
   return sequences;
 }
 
-std::vector<std::unique_ptr<biosoup::Sequence>> LoadSequences(
-    std::string const& path) {
-  auto sparser = CreateParser(path);
-  auto sequences = sparser->Parse(-1);
+PackedSequences LoadSequences(
+    std::vector<std::string> const& paths,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+    bool defer_qualities) {
+  std::vector<PackedSequences> parts(paths.size());
+  detail::ForEachInput(paths.size(), thread_pool, [&] (std::size_t i) -> void {
+    SequenceStream stream(CreateParser(paths[i], thread_pool), false,
+                          defer_qualities);
+    while (true) {
+      auto batch = stream.Next();
+      if (batch.empty()) {
+        break;
+      }
+      parts[i].Append(std::move(batch));
+    }
+  });
+
+  PackedSequences sequences;
+  for (std::uint32_t i = 0; i < parts.size(); ++i) {  // ids follow paths
+    sequences.Append(std::move(parts[i]), i);
+  }
 
   if (sequences.empty()) {
     throw std::runtime_error("[raven::] error: empty sequences set");
@@ -78,8 +163,265 @@ std::vector<std::unique_ptr<biosoup::Sequence>> LoadSequences(
   return sequences;
 }
 
-std::vector<std::unique_ptr<biosoup::Sequence>> LoadFillerSeqs() {
-  return LoadSequences(constants::kFillerSeqsPath);
+SequenceStore::SequenceStore(
+    std::vector<std::string> paths,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool)
+    : paths_(std::move(paths)), thread_pool_(thread_pool) {}
+
+void SequenceStore::FetchBases(
+    PackedSequences& sequences, const std::vector<std::uint32_t>& ids) const {
+  Read(sequences, ids, [&] (std::uint32_t id, const SequenceView& view) {
+    sequences.set_bases(id, PackedSequence(view.data, view.data_len));
+  });
+}
+
+void SequenceStore::FetchQualities(
+    PackedSequences& sequences, const std::vector<std::uint32_t>& ids) const {
+  Read(sequences, ids, [&] (std::uint32_t id, const SequenceView& view) {
+    if (view.quality) {
+      sequences.set_quality(id, StripLineBreaks(view.quality,
+                                                view.quality_len));
+    }
+  });
+}
+
+void SequenceStore::Read(
+    const PackedSequences& sequences, const std::vector<std::uint32_t>& ids,
+    const std::function<void(std::uint32_t, const SequenceView&)>& take)
+    const {
+  std::vector<std::vector<std::uint32_t>> inputs(paths_.size());
+  for (const auto& it : ids) {
+    inputs[sequences.origin(it).input].emplace_back(it);
+  }
+
+  detail::ForEachInput(paths_.size(), thread_pool_, [&] (std::size_t i) {
+    auto& ids = inputs[i];
+    if (ids.empty()) {
+      return;
+    }
+    std::sort(ids.begin(), ids.end(),
+        [&] (std::uint32_t lhs, std::uint32_t rhs) -> bool {
+          return sequences.origin(lhs).offset < sequences.origin(rhs).offset;
+        });
+
+    auto parser = CreateParser(paths_[i], thread_pool_);
+    if (parser == nullptr) {
+      throw std::invalid_argument(
+          "[raven::util::SequenceStore] error: unable to reopen " + paths_[i]);
+    }
+    auto changed = std::runtime_error(
+        "[raven::util::SequenceStore] error: " + paths_[i] + " has changed");
+
+    if (parser->Seek(0)) {  // jump from record to record
+      for (const auto& it : ids) {
+        auto offset = sequences.origin(it).offset;
+        parser->Seek(offset);
+        auto chunk = parser->Parse(1);
+        if (chunk.empty() || chunk.front().offset != offset) {
+          throw changed;
+        }
+        take(it, chunk.front());
+      }
+      return;
+    }
+
+    auto it = ids.begin();
+    while (it != ids.end()) {
+      auto chunk = parser->Parse(constants::kParseChunkLim);
+      if (chunk.empty()) {
+        break;
+      }
+      for (const auto& jt : chunk) {
+        if (it != ids.end() && jt.offset == sequences.origin(*it).offset) {
+          take(*it++, jt);
+        }
+      }
+    }
+    if (it != ids.end()) {
+      throw changed;
+    }
+  });
+}
+
+void LoadQualities(
+    std::vector<std::string> const& paths, PackedSequences& sequences,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  std::vector<std::uint32_t> ids;
+  for (std::uint32_t i = 0; i < sequences.size(); ++i) {
+    if (sequences.quality(i).empty() && sequences.has_quality(i)) {
+      ids.emplace_back(i);
+    }
+  }
+  SequenceStore(paths, thread_pool).FetchQualities(sequences, ids);
+}
+
+void LoadOverlaps(
+    std::string const& path, PackedSequences const& sequences,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+    std::function<void(std::vector<biosoup::Overlap>&&)> const& take) {
+  std::unordered_map<std::string, std::uint32_t> name_to_id;
+  name_to_id.reserve(sequences.size());
+  for (std::uint32_t i = 0; i < sequences.size(); ++i) {
+    name_to_id.emplace(sequences.name(i), i);
+  }
+
+  auto invalid = std::invalid_argument(
+      "[raven::util::LoadOverlaps] error: invalid PAF record in " + path);
+
+  // fills o from line [begin, end), false if any of the reads is unknown
+  std::string name;
+  auto parse = [&] (const char* begin, const char* end,
+                    biosoup::Overlap& o) -> bool {
+    const char* fields[11];
+    std::uint32_t num_fields = 0;
+    for (auto it = begin; it < end && num_fields < 11;) {
+      fields[num_fields++] = it;
+      it = static_cast<const char*>(std::memchr(it, '\t', end - it));
+      if (it == nullptr) {
+        break;
+      }
+      ++it;
+    }
+    if (num_fields < 10) {
+      throw invalid;
+    }
+    auto number = [&] (std::uint32_t i) -> std::uint32_t {
+      return std::strtoul(fields[i], nullptr, 10);
+    };
+    auto id = [&] (std::uint32_t i, std::uint32_t& dst) -> bool {
+      name.assign(fields[i], fields[i + 1] - 1 - fields[i]);
+      auto it = name_to_id.find(name);
+      if (it == name_to_id.end() ||
+          sequences.length(it->second) != number(i + 1)) {
+        return false;
+      }
+      dst = it->second;
+      return true;
+    };
+    if (!id(0, o.lhs_id) || !id(5, o.rhs_id) || o.lhs_id == o.rhs_id) {
+      return false;
+    }
+    o.lhs_begin = number(2);
+    o.lhs_end = number(3);
+    o.strand = fields[4][0] == '+';
+    o.rhs_begin = number(7);
+    o.rhs_end = number(8);
+    o.score = number(9);
+    return true;
+  };
+
+  Decompressor decompressor(path, thread_pool);
+  std::string buffer;
+  std::uint64_t num_skipped = 0;
+  while (true) {
+    auto chunk = decompressor.Next();
+    auto is_last = chunk.empty();
+    buffer += chunk;
+    std::string().swap(chunk);
+
+    std::vector<biosoup::Overlap> overlaps;
+    std::uint64_t pos = 0;
+    while (pos < buffer.size()) {
+      auto eol = static_cast<const char*>(
+          std::memchr(buffer.data() + pos, '\n', buffer.size() - pos));
+      if (eol == nullptr && !is_last) {
+        break;
+      }
+      auto end = eol ? eol - buffer.data() : buffer.size();
+      if (end > pos && buffer[end - 1] == '\r') {
+        --end;
+      }
+      if (end > pos) {
+        biosoup::Overlap o;
+        if (parse(buffer.data() + pos, buffer.data() + end, o)) {
+          overlaps.emplace_back(o);
+        } else {
+          ++num_skipped;
+        }
+      }
+      pos = eol ? eol - buffer.data() + 1 : buffer.size();
+    }
+    buffer.erase(0, pos);
+
+    if (!overlaps.empty()) {
+      take(std::move(overlaps));
+    }
+    if (is_last) {
+      break;
+    }
+  }
+
+  if (num_skipped > 0) {
+    std::cerr << "[raven::util::LoadOverlaps] warning: skipped " << num_skipped
+              << " records of unknown or mismatched reads" << std::endl;
+  }
+}
+
+std::vector<InputFingerprint> FingerprintInputs(
+    std::vector<std::string> const& paths) {
+  std::vector<InputFingerprint> dst;
+  for (const auto& it : paths) {
+    struct stat st;
+    if (stat(it.c_str(), &st) != 0) {
+      throw std::invalid_argument(
+          "[raven::util::FingerprintInputs] error: unable to stat " + it);
+    }
+    dst.push_back(InputFingerprint{it, static_cast<std::uint64_t>(st.st_size),
+                                   static_cast<std::int64_t>(st.st_mtime)});
+  }
+  return dst;
+}
+
+void StoreIndex(std::vector<std::string> const& paths,
+                PackedSequences const& sequences) {
+  std::ofstream os(constants::kIndexPath);
+  try {
+    cereal::BinaryOutputArchive archive(os);
+    archive(FingerprintInputs(paths), sequences);
+  } catch (std::exception&) {
+    throw std::logic_error(
+        "[raven::util::StoreIndex] error: unable to store index");
+  }
+}
+
+bool LoadIndex(std::vector<std::string> const& paths,
+               PackedSequences& sequences) {
+  std::ifstream is(constants::kIndexPath);
+  if (!is.is_open()) {
+    return false;
+  }
+
+  std::vector<InputFingerprint> fingerprints;
+  PackedSequences dst;
+  try {
+    cereal::BinaryInputArchive archive(is);
+    archive(fingerprints);
+
+    auto expected = FingerprintInputs(paths);
+    if (fingerprints.size() != expected.size() ||
+        !std::equal(fingerprints.begin(), fingerprints.end(), expected.begin(),
+            [] (const InputFingerprint& lhs,
+                const InputFingerprint& rhs) -> bool {
+              return lhs.path == rhs.path && lhs.size == rhs.size &&
+                     lhs.mtime == rhs.mtime;
+            })) {
+      std::cerr << "[raven::util::LoadIndex] warning: inputs have changed"
+                << std::endl;
+      return false;
+    }
+
+    archive(dst);
+  } catch (std::exception&) {
+    std::cerr << "[raven::util::LoadIndex] warning: unable to load index"
+              << std::endl;
+    return false;
+  }
+
+  if (dst.empty()) {
+    return false;
+  }
+  sequences = std::move(dst);
+  return true;
 }
 
 std::vector<std::unique_ptr<biosoup::Sequence>>& TrimSequences(
@@ -100,6 +442,28 @@ std::vector<std::unique_ptr<biosoup::Sequence>>& TrimSequences(
   return sequences;
 }
 
+void ParallelFor(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+                 std::uint32_t size,
+                 const std::function<void(std::uint32_t, std::uint32_t)>& f) {
+  std::uint32_t num_ranges = thread_pool ? thread_pool->num_threads() : 1;
+  if (num_ranges < 2) {
+    f(0, size);
+    return;
+  }
+  std::uint32_t range_len = (size + num_ranges - 1) / num_ranges;
+  std::vector<std::future<void>> futures;
+  for (std::uint32_t i = 0; i < size; i += range_len) {
+    futures.emplace_back(thread_pool->Submit(
+        f, i, std::min(size, i + range_len)));
+  }
+  for (const auto& it : futures) {
+    it.wait();
+  }
+  for (auto& it : futures) {  // rethrows once no task is running
+    it.get();
+  }
+}
+
 }  // namespace util
 
 }  // namespace raven
\ No newline at end of file
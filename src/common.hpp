@@ -3,15 +3,23 @@
 #ifndef RAVEN_COMMON_HPP_
 #define RAVEN_COMMON_HPP_
 
-#include "bioparser/fasta_parser.hpp"
-#include "bioparser/fastq_parser.hpp"
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "biosoup/overlap.hpp"
 #include "biosoup/sequence.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+#include "packed_sequence.hpp"
+#include "parser.hpp"
 
 namespace raven {
 namespace constants {
 
-char constexpr kFillerSeqsPath[] = "extracted.fasta";
-
 std::size_t constexpr kMinSequenceLen = 1000;
 
 float constexpr kKMerDiscardFreqHard = 0.001;
@@ -25,8 +33,14 @@ std::size_t constexpr kSeqsBatchLim = 1ULL << 32;
 
 std::size_t constexpr kOvlpBatchLim = 1ULL << 30;
 
+// number of input bytes handed to the parser per call while streaming
+std::size_t constexpr kParseChunkLim = 1ULL << 28;
+
 std::size_t constexpr kFillerLenLim = 20000;
 
+// read index stored next to the graph checkpoint
+char constexpr kIndexPath[] = "raven.index";
+
 // number of overlaps used per lhs in greedy construction/assembly
 std::size_t constexpr kMaxGreedyOvlp = 8; // TODO: consider removing
 
@@ -34,8 +48,60 @@ std::size_t constexpr kMaxGreedyOvlp = 8; // TODO: consider removing
 
 namespace util {
 
-std::unique_ptr<bioparser::Parser<biosoup::Sequence>> CreateParser(
-    const std::string& path);
+// pulls sequences from a parser in batches of roughly batch_bytes bases,
+// with prefetch the next batch is parsed and packed on a separate thread while
+// the current one is in use (not on the thread pool, as compressed inputs are
+// inflated there); sequences shorter than kMinSequenceLen are dropped, with
+// defer_qualities only the mean quality of each read is kept
+class SequenceStream {
+ public:
+  SequenceStream(std::unique_ptr<SequenceParser> parser, bool prefetch = false,
+                 bool defer_qualities = false,
+                 std::uint64_t batch_bytes = constants::kSeqsBatchLim);
+
+  SequenceStream(const SequenceStream&) = delete;
+  SequenceStream& operator=(const SequenceStream&) = delete;
+
+  ~SequenceStream();
+
+  // ids start from zero in every batch, empty once the input is exhausted
+  PackedSequences Next();
+
+ private:
+  PackedSequences ParseBatch();
+
+  std::unique_ptr<SequenceParser> parser_;
+  bool prefetch_;
+  bool defer_qualities_;
+  std::uint64_t batch_bytes_;
+  std::future<PackedSequences> next_;
+};
+
+// reads records back from the inputs through the index kept in
+// PackedSequences; uncompressed files are read at the recorded offsets,
+// compressed ones are streamed once per fetch
+class SequenceStore {
+ public:
+  SequenceStore(
+      std::vector<std::string> paths,
+      std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+  void FetchBases(PackedSequences& sequences,
+                  const std::vector<std::uint32_t>& ids) const;
+
+  void FetchQualities(PackedSequences& sequences,
+                      const std::vector<std::uint32_t>& ids) const;
+
+ private:
+  // calls take with the record of every id
+  void Read(
+      const PackedSequences& sequences, const std::vector<std::uint32_t>& ids,
+      const std::function<void(std::uint32_t, const SequenceView&)>& take)
+      const;
+
+  std::vector<std::string> paths_;
+  std::shared_ptr<thread_pool::ThreadPool> thread_pool_;
+};
 
 // takes ownership of both containers
 std::vector<std::unique_ptr<biosoup::Sequence>> MergeSequences(
@@ -45,15 +111,62 @@ std::vector<std::unique_ptr<biosoup::Sequence>> MergeSequences(
 std::vector<std::unique_ptr<biosoup::Sequence>>& NormalizeSeqIds(
     std::vector<std::unique_ptr<biosoup::Sequence>>& sequences);
 
-std::vector<std::unique_ptr<biosoup::Sequence>> LoadSequences(
-    std::string const& path);
-
-std::vector<std::unique_ptr<biosoup::Sequence>> LoadFillerSeqs();
+// parses files concurrently into one id space following the order of paths,
+// compressed inputs are inflated on thread_pool if one is given
+PackedSequences LoadSequences(
+    std::vector<std::string> const& paths,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr,
+    bool defer_qualities = false);
+
+// streams the inputs again to fill in qualities dropped while loading,
+// records are matched by their offsets
+void LoadQualities(
+    std::vector<std::string> const& paths, PackedSequences& sequences,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+// reads overlaps from a PAF file (can be compressed with gzip or bgzip) and
+// hands them to take in batches, query as lhs and target as rhs; reads are
+// resolved by name, records of reads missing from sequences are skipped
+void LoadOverlaps(
+    std::string const& path, PackedSequences const& sequences,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+    std::function<void(std::vector<biosoup::Overlap>&&)> const& take);
+
+// identifies an input without reading it
+struct InputFingerprint {
+  template <class Archive>
+  void serialize(Archive& archive) {  // NOLINT
+    archive(path, size, mtime);
+  }
+
+  std::string path;
+  std::uint64_t size;
+  std::int64_t mtime;
+};
+
+std::vector<InputFingerprint> FingerprintInputs(
+    std::vector<std::string> const& paths);
+
+// stores names, mean qualities and origins of sequences next to the graph
+// checkpoint so that resumed runs can skip parsing the inputs
+void StoreIndex(std::vector<std::string> const& paths,
+                PackedSequences const& sequences);
+
+// false if there is no index of the given inputs, otherwise sequences are
+// replaced with evicted ones to be fetched back through a SequenceStore
+bool LoadIndex(std::vector<std::string> const& paths,
+               PackedSequences& sequences);
 
 // modifies the original collection
 std::vector<std::unique_ptr<biosoup::Sequence>>& TrimSequences(
     std::vector<std::unique_ptr<biosoup::Sequence>>& sequences);
 
+// ids [0, size) are split into ranges, one per thread, and f is called with
+// each of them on thread_pool (or once with all ids without one)
+void ParallelFor(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+                 std::uint32_t size,
+                 const std::function<void(std::uint32_t, std::uint32_t)>& f);
+
 }  // namespace util
 
 }  // namespace raven
@@ -1,11 +1,13 @@
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <iterator>
 #include <getopt.h>
-#include <fstream>
 
 #include "controller.hpp"
 #include "common.hpp"
+#include "writer.hpp"
 
 namespace raven {
 
@@ -13,6 +15,9 @@ namespace detail {
 
 static struct option options[] = {
     {"weaken", no_argument, nullptr, 'w'},
+    {"stream", no_argument, nullptr, 'S'},
+    {"defer-qualities", no_argument, nullptr, 'Q'},
+    {"lazy-sequences", no_argument, nullptr, 'L'},
     {"polishing-rounds", required_argument, nullptr, 'p'},
     {"match", required_argument, nullptr, 'm'},
     {"mismatch", required_argument, nullptr, 'n'},
@@ -23,16 +28,49 @@ static struct option options[] = {
     {"cuda-alignment-batches", required_argument, nullptr, 'a'},
 #endif
     {"graphical-fragment-assembly", required_argument, nullptr, 'f'},
+    {"line-width", required_argument, nullptr, 'W'},
+    {"gzip-output", no_argument, nullptr, 'z'},
     {"second-run", no_argument, nullptr, 's'},
     {"resume", no_argument, nullptr, 'r'},
+    {"store-index", no_argument, nullptr, 'I'},
     {"threads", required_argument, nullptr, 't'},
+    {"memory-limit", required_argument, nullptr, 'M'},
+    {"spill-limit", required_argument, nullptr, 'O'},
+    {"spill-dir", required_argument, nullptr, 'D'},
+    {"overlaps", required_argument, nullptr, 'P'},
+    {"overlap-cache", required_argument, nullptr, 'C'},
     {"version", no_argument, nullptr, 'v'},
     {"help", no_argument, nullptr, 'h'},
     {nullptr, 0, nullptr, 0}};
 
+// inputs can be read again, not possible with stdin
+bool IsSeekable(Config const& conf) {
+  return std::find(conf.sequence_paths.begin(), conf.sequence_paths.end(),
+                   "-") == conf.sequence_paths.end();
+}
+
 void RavenRun(Config const& conf, Data& data) {
-  data.graph.Construct(data.sequences);
+  auto const is_parsed = data.graph.stage() < -3;
+  data.graph.Construct(data.sequences, data.stream.get());
+  // all sequences are in by now
+  if (conf.store_index && is_parsed && IsSeekable(conf)) {
+    util::StoreIndex(conf.sequence_paths, data.sequences);
+  }
+
   data.graph.Assemble();
+
+  if ((conf.defer_qualities || data.is_indexed) &&
+      conf.num_polishing_rounds > std::max(0, data.graph.stage())) {
+    biosoup::Timer timer{};
+    timer.Start();
+
+    util::LoadQualities(conf.sequence_paths, data.sequences,
+                        data.thread_pool);
+
+    std::cerr << "[raven::] loaded deferred qualities " << std::fixed
+              << timer.Stop() << "s" << std::endl;
+  }
+
   data.graph.Polish(data.sequences, conf.m, conf.n, conf.g,
                     conf.cuda_poa_batches, conf.cuda_banded_alignment,
                     conf.cuda_alignment_batches, conf.num_polishing_rounds);
@@ -41,10 +79,12 @@ void RavenRun(Config const& conf, Data& data) {
 void RavenPrintResults(Config const& conf, Data& data) {
   data.graph.PrintGFA(conf.gfa_path);
 
-  for (auto const& it : data.graph.GetUnitigs(conf.num_polishing_rounds > 0)) {
-    std::cout << ">" << it->name << std::endl;
-    std::cout << it->data << std::endl;
-  }
+  auto unitigs = data.graph.GetUnitigs(conf.num_polishing_rounds > 0);
+  util::Writer writer("-", data.thread_pool, conf.gzip_output);
+  writer.Write(unitigs.size(), [&] (std::size_t i, std::string& dst) -> void {
+    util::AppendFasta(unitigs[i]->name, unitigs[i]->data, conf.line_width,
+                      dst);
+  });
 
   data.timer.Stop();
   std::cerr << "[raven::] " << std::fixed << data.timer.elapsed_time() << "s"
@@ -71,7 +111,8 @@ void DoubleRun(Config const& conf, Data& data) {
   data.graph.Clear();
   data.timer.Start();
 
-  auto const expected = data.graph.GreedyConstruct(util::NormalizeSeqIds(unitigs));
+  auto const expected = data.graph.GreedyConstruct(
+      util::NormalizeSeqIds(unitigs), data.sequences);
   data.graph.GreedyAssemble(expected);
 
 
@@ -94,6 +135,15 @@ Config ParseConfig(int argc, char** argv) {
       case 'w':
         conf.weaken = true;
         break;
+      case 'S':
+        conf.stream = true;
+        break;
+      case 'Q':
+        conf.defer_qualities = true;
+        break;
+      case 'L':
+        conf.lazy_sequences = true;
+        break;
       case 'p':
         conf.num_polishing_rounds = atoi(optarg);
         break;
@@ -128,15 +178,42 @@ Config ParseConfig(int argc, char** argv) {
       case 'f':
         conf.gfa_path = optarg;
         break;
+      case 'W':
+        conf.line_width = atoi(optarg);
+        break;
+      case 'z':
+        conf.gzip_output = true;
+        break;
       case 'r':
         conf.resume = true;
         break;
+      case 'I':
+        conf.store_index = true;
+        break;
       case 's':
         conf.second_run = true;
         break;
       case 't':
         conf.num_threads = atoi(optarg);
         break;
+      case 'M':
+        conf.memory_limit = std::strtoull(optarg, nullptr, 10) << 30;
+        if (conf.memory_limit == 0) {
+          conf.memory_limit = util::AvailableMemory() / 4 * 3;
+        }
+        break;
+      case 'O':
+        conf.spill_limit = std::strtoull(optarg, nullptr, 10) << 30;
+        break;
+      case 'D':
+        conf.spill_dir = optarg;
+        break;
+      case 'P':
+        conf.overlaps_path = optarg;
+        break;
+      case 'C':
+        conf.overlap_cache_path = optarg;
+        break;
       case 'v':
         std::cout << raven_version << std::endl;
         conf.run = false;
@@ -153,7 +230,7 @@ Config ParseConfig(int argc, char** argv) {
     Help();
     throw std::runtime_error("[raven::] error: missing input file!");
   } else if (conf.run) {
-    conf.sequence_path = argv[optind];
+    conf.sequence_paths.assign(argv + optind, argv + argc);
   }
 
   return conf;
@@ -161,15 +238,24 @@ Config ParseConfig(int argc, char** argv) {
 
 void Help() {
   std::cout
-      << "usage: metaraven [options ...] <sequences>\n"
+      << "usage: metaraven [options ...] <sequences> [<sequences> ...]\n"
          "\n"
          "  # default output is stdout\n"
          "  <sequences>\n"
-         "    input file in FASTA/FASTQ format (can be compressed with gzip)\n"
+         "    input file in FASTA/FASTQ format (can be compressed with gzip or bgzip)\n"
+         "    or - for stdin, several files are parsed concurrently\n"
          "\n"
          "  options:\n"
          "    --weaken\n"
          "      use larger (k, w) when assembling highly accurate sequences\n"
+         "    --stream\n"
+         "      parse sequences in batches while the previous ones are mapped\n"
+         "    --defer-qualities\n"
+         "      drop qualities until polishing and read them again from the\n"
+         "      input files (kept as parsed when reading from stdin)\n"
+         "    --lazy-sequences\n"
+         "      keep only sequences in use in memory and read the others\n"
+         "      back from the input files when needed (not with stdin)\n"
          "    -p, --polishing-rounds <int>\n"
          "      default: 2\n"
          "      number of times racon is invoked\n"
@@ -197,11 +283,38 @@ void Help() {
          "      reuses non-chimeric in combination with unitigs"
          "    --graphical-fragment-assembly <string>\n"
          "      prints the assemblg graph in GFA format\n"
+         "      (compressed with gzip if the path ends with .gz)\n"
+         "    --line-width <int>\n"
+         "      default: 0\n"
+         "      wraps output sequences every <int> bases (0 for no wrapping)\n"
+         "    --gzip-output\n"
+         "      compresses the output with gzip\n"
          "    --resume\n"
          "      resume previous run from last checkpoint\n"
+         "    --store-index\n"
+         "      stores names and offsets of sequences next to the checkpoints\n"
+         "      so that a resumed run does not parse the inputs (not with\n"
+         "      stdin)\n"
          "    -t, --threads <int>\n"
          "      default: 1\n"
          "      number of threads\n"
+         "    --memory-limit <int>\n"
+         "      sizes batches of reads to fit into <int> GB of memory (0 for\n"
+         "      3/4 of the physical memory or of the cgroup limit) instead\n"
+         "      of using fixed batch sizes\n"
+         "    --spill-limit <int>\n"
+         "      default: 0\n"
+         "      keeps up to <int> GB of overlaps between valid reads in memory\n"
+         "      and spills the rest to disk (0 keeps all of them in memory)\n"
+         "    --spill-dir <string>\n"
+         "      default: .\n"
+         "      directory for spilled overlaps\n"
+         "    --overlaps <string>\n"
+         "      takes overlaps from a PAF file (can be compressed with gzip)\n"
+         "      instead of mapping the reads to each other\n"
+         "    --overlap-cache <string>\n"
+         "      reuses overlaps stored in the file by a previous run on the\n"
+         "      same inputs, otherwise stores them there (not with stdin)\n"
          "    --version\n"
          "      prints the version number\n"
          "    -h, --help\n"
@@ -210,13 +323,27 @@ void Help() {
 
 Data::Data(Config const& conf)
     : sequences{},
+      stream{},
       thread_pool{std::make_shared<thread_pool::ThreadPool>(conf.num_threads)},
       graph{conf.weaken, thread_pool} {
+  graph.set_spill(conf.spill_dir, conf.spill_limit);
+  graph.set_memory_limit(conf.memory_limit);
+  graph.set_overlaps_path(conf.overlaps_path);
+  if (!conf.overlap_cache_path.empty()) {
+    if (detail::IsSeekable(conf)) {
+      graph.set_overlap_cache(conf.overlap_cache_path,
+                              util::FingerprintInputs(conf.sequence_paths));
+    } else {
+      std::cerr << "[raven::] warning: overlaps of stdin are not cached"
+                << std::endl;
+    }
+  }
   timer.Start();
 }
 
 Data::Data(bool const weaken, std::uint32_t const num_threads)
     : sequences{},
+      stream{},
       thread_pool{std::make_shared<thread_pool::ThreadPool>(num_threads)},
       graph{weaken, thread_pool} {
   timer.Start();
@@ -224,7 +351,6 @@ Data::Data(bool const weaken, std::uint32_t const num_threads)
 
 Data Setup(Config const& conf) {
   Data data(conf);
-  auto sparser = util::CreateParser(conf.sequence_path);
 
   if (conf.resume) {
     data.graph.Load();
@@ -233,20 +359,43 @@ Data Setup(Config const& conf) {
               << data.timer.Stop() << "s" << std::endl;
   }
 
-  if (conf.second_run) {
-    std::ofstream os{constants::kFillerSeqsPath, std::ios_base::trunc};
-  }
-
-  if (data.graph.stage() < -3 ||
-      conf.num_polishing_rounds > std::max(0, data.graph.stage())) {
-    data.sequences = util::LoadSequences(conf.sequence_path);
-
-    std::cerr << "[raven::] loaded " << data.sequences.size() << " sequences "
-              << std::fixed << data.timer.Stop() << "s" << std::endl;
+  auto is_seekable = detail::IsSeekable(conf);
+  // only worth it if assembling first
+  auto defer_qualities =
+      conf.defer_qualities && data.graph.stage() < -3 && is_seekable;
+
+  if (conf.stream && data.graph.stage() == -5) {
+    data.stream = std::unique_ptr<util::SequenceStream>(
+        new util::SequenceStream(
+            util::CreateParser(conf.sequence_paths, data.thread_pool), true,
+            defer_qualities, data.graph.planner().StreamBases()));
+  } else if (data.graph.stage() < -3 || conf.second_run ||
+             conf.num_polishing_rounds > std::max(0, data.graph.stage())) {
+    // past mapping only Polish and GreedyConstruct need bases, fetched then
+    if (data.graph.stage() > -4 && is_seekable &&
+        util::LoadIndex(conf.sequence_paths, data.sequences)) {
+      data.is_indexed = true;
+
+      std::cerr << "[raven::] loaded index of " << data.sequences.size()
+                << " sequences " << std::fixed << data.timer.Stop() << "s"
+                << std::endl;
+    } else {
+      data.sequences = util::LoadSequences(conf.sequence_paths,
+                                           data.thread_pool, defer_qualities);
+
+      std::cerr << "[raven::] loaded " << data.sequences.size()
+                << " sequences " << std::fixed << data.timer.Stop() << "s"
+                << std::endl;
+    }
 
     data.timer.Start();
   }
 
+  if ((conf.lazy_sequences || data.is_indexed) && is_seekable) {
+    data.sequences.set_store(std::make_shared<util::SequenceStore>(
+        conf.sequence_paths, data.thread_pool));
+  }
+
   return data;
 }  // namespace raven
 
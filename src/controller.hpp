@@ -25,22 +25,35 @@ struct Config {
   bool second_run = false;
 
   bool weaken = false;
+  bool stream = false;
+  bool defer_qualities = false;
+  bool lazy_sequences = false;
 
   std::int32_t num_polishing_rounds = 2;
   std::int8_t m = 3;
   std::int8_t n = -5;
   std::int8_t g = -4;
 
-  std::string gfa_path = "";
+  std::string gfa_path = "";  // compressed if it ends with .gz
+  std::uint32_t line_width = 0;  // 0 for unwrapped FASTA
+  bool gzip_output = false;
   bool resume = false;
+  bool store_index = false;
 
   std::uint32_t num_threads = 1;
+  std::uint64_t memory_limit = 0;  // bytes, 0 for fixed batch sizes
+
+  std::string spill_dir = ".";
+  std::uint64_t spill_limit = 0;  // bytes, 0 for no spilling
+
+  std::string overlaps_path = "";  // PAF, mapping is skipped if set
+  std::string overlap_cache_path = "";
 
   std::uint32_t cuda_poa_batches = 0;
   std::uint32_t cuda_alignment_batches = 0;
   bool cuda_banded_alignment = false;
 
-  std::string sequence_path;
+  std::vector<std::string> sequence_paths;  // "-" is stdin
 };
 
 struct Data {
@@ -48,7 +61,9 @@ public:
   Data(Config const& conf);
   Data(bool weaken, std::uint32_t num_threads);
 
-  std::vector<std::unique_ptr<biosoup::Sequence>> sequences;
+  PackedSequences sequences;
+  bool is_indexed = false;  // loaded evicted from the read index
+  std::unique_ptr<util::SequenceStream> stream;
   std::shared_ptr<thread_pool::ThreadPool> thread_pool;
   raven::Graph graph;
 
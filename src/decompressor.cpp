@@ -0,0 +1,339 @@
+#include "decompressor.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+namespace raven {
+namespace util {
+
+namespace detail {
+
+// compressed bytes read per chunk
+std::uint64_t constexpr kInflateChunk = 1ULL << 24;
+
+// compressed bytes of consecutive BGZF blocks inflated by one task
+std::uint64_t constexpr kBgzfBatch = 1ULL << 20;
+
+// inflated bytes produced by one sequential step
+std::uint64_t constexpr kInflateStep = 1ULL << 24;
+
+bool IsMemberHeader(const char* data, std::uint64_t len) {
+  return len >= 10 && static_cast<std::uint8_t>(data[0]) == 0x1f &&
+         static_cast<std::uint8_t>(data[1]) == 0x8b && data[2] == 8 &&
+         (data[3] & 0xe0) == 0;
+}
+
+// size of the BGZF block starting at data, 0 if it is not one
+std::uint64_t BgzfBlockSize(const char* data, std::uint64_t len) {
+  if (!IsMemberHeader(data, len) || len < 18 || !(data[3] & 4)) {
+    return 0;
+  }
+  auto byte = [&] (std::uint64_t i) -> std::uint64_t {
+    return static_cast<std::uint8_t>(data[i]);
+  };
+  std::uint64_t xlen = byte(10) | byte(11) << 8;
+  for (std::uint64_t i = 12; i + 4 <= 12 + xlen && i + 4 <= len;) {
+    std::uint64_t slen = byte(i + 2) | byte(i + 3) << 8;
+    if (data[i] == 'B' && data[i + 1] == 'C' && slen == 2 && i + 6 <= len) {
+      return (byte(i + 4) | byte(i + 5) << 8) + 1;
+    }
+    i += 4 + slen;
+  }
+  return 0;
+}
+
+// inflates one gzip member into dst, returns the number of consumed bytes or
+// 0 if the member is invalid or does not end within len
+std::uint64_t InflateMember(const char* data, std::uint64_t len,
+                            std::string& dst) {
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+    return 0;
+  }
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  zs.avail_in = len;
+
+  auto begin = dst.size();
+  int ret = Z_OK;
+  while (ret == Z_OK) {
+    auto produced = dst.size() - begin;
+    dst.resize(begin + produced + std::max<std::uint64_t>(produced, 1U << 16));
+    zs.next_out = reinterpret_cast<Bytef*>(&dst[begin + produced]);
+    zs.avail_out = dst.size() - begin - produced;
+
+    ret = inflate(&zs, Z_NO_FLUSH);
+    dst.resize(begin + zs.total_out);
+    if (ret == Z_OK && zs.avail_in == 0 && zs.avail_out != 0) {
+      break;  // truncated
+    }
+  }
+  std::uint64_t consumed = zs.total_in;
+  inflateEnd(&zs);
+
+  if (ret != Z_STREAM_END) {
+    dst.resize(begin);
+    return 0;
+  }
+  return consumed;
+}
+
+}  // namespace detail
+
+Decompressor::Decompressor(
+    const std::string& path,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool)
+    : fd_(path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY)),
+      is_eof_(false),
+      is_plain_(false),
+      input_(),
+      begin_(0),
+      thread_pool_(thread_pool),
+      members_(),
+      step_(),
+      stream_() {
+  if (fd_ == -1) {
+    throw std::invalid_argument(
+        "[raven::util::Decompressor] error: unable to open file " + path);
+  }
+  Read();
+  is_plain_ = !detail::IsMemberHeader(input_.data(), input_.size());
+}
+
+Decompressor::~Decompressor() {
+  for (const auto& it : members_) {  // tasks point into input_
+    it.second.wait();
+  }
+  if (step_.valid()) {
+    step_.wait();
+  }
+  if (stream_) {
+    inflateEnd(stream_.get());
+  }
+  if (fd_ != STDIN_FILENO) {
+    close(fd_);
+  }
+}
+
+std::string Decompressor::Next() {
+  if (is_plain_) {
+    Read();
+    auto dst = input_.substr(begin_);
+    begin_ = input_.size();
+    return dst;
+  }
+  while (true) {
+    if (members_.empty() && !step_.valid()) {
+      Submit();
+    }
+    if (members_.empty() && !step_.valid()) {
+      return std::string();
+    }
+    auto dst = Collect();
+    Submit();  // inflate ahead while dst is parsed
+    if (!dst.empty()) {
+      return dst;
+    }
+  }
+}
+
+bool Decompressor::Read() {
+  if (is_eof_ || input_.size() - begin_ >= detail::kInflateChunk / 2) {
+    return !is_eof_;
+  }
+  input_.erase(0, begin_);
+  begin_ = 0;
+  while (!is_eof_ && input_.size() < detail::kInflateChunk) {
+    auto begin = input_.size();
+    input_.resize(detail::kInflateChunk);
+    auto len = read(fd_, &input_[begin], input_.size() - begin);
+    if (len < 0) {
+      throw std::runtime_error(
+          "[raven::util::Decompressor::Read] error: unable to read input");
+    }
+    input_.resize(begin + len);
+    is_eof_ = len == 0;
+  }
+  return !is_eof_;
+}
+
+void Decompressor::Submit() {
+  auto run = [&] (std::function<Inflated()> task) -> std::future<Inflated> {
+    return thread_pool_ ? thread_pool_->Submit(task)
+                        : std::async(std::launch::deferred, task);
+  };
+
+  Read();
+
+  if (stream_) {
+    step_ = run([this] () -> Inflated { return InflateStep(); });
+    return;
+  }
+  const char* data = input_.data() + begin_;
+  std::uint64_t size = input_.size() - begin_;
+  if (size == 0) {
+    return;
+  }
+  if (!detail::IsMemberHeader(data, size)) {
+    if (is_eof_) {  // trailing garbage
+      begin_ = input_.size();
+      return;
+    }
+    throw std::invalid_argument(
+        "[raven::util::Decompressor] error: invalid gzip member");
+  }
+
+  // consecutive BGZF blocks, offsets are known upfront
+  std::uint64_t pos = 0;
+  for (std::uint64_t block_size; (block_size = detail::BgzfBlockSize(
+           data + pos, size - pos)) > 0 && pos + block_size <= size;) {
+    auto begin = pos;
+    while (pos + block_size <= size && pos - begin < detail::kBgzfBatch) {
+      pos += block_size;
+      block_size = detail::BgzfBlockSize(data + pos, size - pos);
+      if (block_size == 0) {
+        break;
+      }
+    }
+    members_.emplace_back(begin, run(
+        [data, begin, pos] () -> Inflated {
+          Inflated dst{0, std::string(), true};
+          std::uint64_t size = 0;  // ISIZE trails every block
+          for (auto it = begin; it < pos;) {
+            auto block_size = detail::BgzfBlockSize(data + it, pos - it);
+            auto isize = reinterpret_cast<const std::uint8_t*>(
+                data + it + block_size - 4);
+            size += isize[0] | isize[1] << 8 | isize[2] << 16 |
+                    static_cast<std::uint32_t>(isize[3]) << 24;
+            it += block_size;
+          }
+          dst.data.reserve(size);
+          for (auto it = begin; it < pos;) {
+            auto consumed = detail::InflateMember(data + it, pos - it,
+                                                  dst.data);
+            if (consumed == 0) {
+              break;
+            }
+            it += consumed;
+            dst.consumed += consumed;
+          }
+          return dst;
+        }));
+  }
+  if (!members_.empty()) {
+    return;
+  }
+
+  // candidate members verified when chained in Collect
+  std::vector<std::uint64_t> offsets;
+  for (std::uint64_t i = 0; i < size; ++i) {
+    auto it = static_cast<const char*>(std::memchr(data + i, 0x1f, size - i));
+    if (it == nullptr) {
+      break;
+    }
+    i = it - data;
+    if (detail::IsMemberHeader(it, size - i)) {
+      offsets.emplace_back(i);
+    }
+  }
+  if (offsets.size() > 1) {
+    for (const auto& it : offsets) {
+      members_.emplace_back(it, run(
+          [data, it, size] () -> Inflated {
+            Inflated dst{0, std::string(), true};
+            dst.consumed = detail::InflateMember(data + it, size - it,
+                                                 dst.data);
+            return dst;
+          }));
+    }
+    return;
+  }
+
+  // single member, inflate it step by step
+  OpenStream();
+  step_ = run([this] () -> Inflated { return InflateStep(); });
+}
+
+void Decompressor::OpenStream() {
+  stream_.reset(new z_stream());
+  std::memset(stream_.get(), 0, sizeof(z_stream));
+  if (inflateInit2(stream_.get(), 16 + MAX_WBITS) != Z_OK) {
+    throw std::runtime_error(
+        "[raven::util::Decompressor] error: unable to initialize zlib");
+  }
+}
+
+std::string Decompressor::Collect() {
+  std::string dst;
+
+  if (step_.valid()) {
+    auto inflated = step_.get();
+    begin_ += inflated.consumed;
+    if (inflated.is_member_end) {
+      inflateEnd(stream_.get());
+      stream_.reset();
+    }
+    return std::move(inflated.data);
+  }
+
+  std::vector<std::pair<std::uint64_t, Inflated>> members;
+  for (auto& it : members_) {
+    members.emplace_back(it.first, it.second.get());
+  }
+  members_.clear();
+
+  std::vector<const std::string*> chain;  // false candidates are skipped
+  std::uint64_t pos = 0;
+  std::uint64_t size = 0;
+  for (const auto& it : members) {
+    if (it.first != pos || it.second.consumed == 0) {
+      continue;
+    }
+    chain.emplace_back(&it.second.data);
+    pos += it.second.consumed;
+    size += it.second.data.size();
+  }
+  dst.reserve(size);
+  for (const auto& it : chain) {
+    dst += *it;
+  }
+
+  if (pos == 0) {  // first member does not fit into a chunk
+    OpenStream();
+  }
+  begin_ += pos;
+
+  return dst;
+}
+
+Decompressor::Inflated Decompressor::InflateStep() {
+  Inflated dst{0, std::string(detail::kInflateStep, '\0'), false};
+
+  stream_->next_in = reinterpret_cast<Bytef*>(&input_[begin_]);
+  stream_->avail_in = input_.size() - begin_;
+  stream_->next_out = reinterpret_cast<Bytef*>(&dst.data[0]);
+  stream_->avail_out = dst.data.size();
+
+  auto ret = inflate(stream_.get(), Z_NO_FLUSH);
+  if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+    throw std::runtime_error(
+        "[raven::util::Decompressor] error: invalid gzip data");
+  }
+  if (ret == Z_BUF_ERROR && is_eof_ && stream_->avail_in == 0) {
+    throw std::runtime_error(
+        "[raven::util::Decompressor] error: truncated gzip data");
+  }
+
+  dst.consumed = input_.size() - begin_ - stream_->avail_in;
+  dst.data.resize(dst.data.size() - stream_->avail_out);
+  dst.is_member_end = ret == Z_STREAM_END;
+  return dst;
+}
+
+}  // namespace util
+}  // namespace raven
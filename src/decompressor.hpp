@@ -0,0 +1,75 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_DECOMPRESSOR_HPP_
+#define RAVEN_DECOMPRESSOR_HPP_
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#include "thread_pool/thread_pool.hpp"
+
+namespace raven {
+namespace util {
+
+// inflates a gzip file chunk by chunk on the thread pool; BGZF blocks are
+// located from their headers and inflated in parallel, members of other
+// multi-member files are inflated in parallel from candidate headers and kept
+// only if they chain up, and a member larger than a chunk is inflated
+// sequentially one step ahead of the consumer; input without a gzip header is
+// passed through as is, "-" reads from stdin
+class Decompressor {
+ public:
+  Decompressor(const std::string& path,
+               std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+  Decompressor(const Decompressor&) = delete;
+  Decompressor& operator=(const Decompressor&) = delete;
+
+  ~Decompressor();
+
+  // next piece of inflated data, empty once the input is exhausted;
+  // must not be called from a thread pool worker
+  std::string Next();
+
+ private:
+  struct Inflated {
+    std::uint64_t consumed;  // compressed bytes, 0 on failure
+    std::string data;
+    bool is_member_end;
+  };
+
+  // compacts and tops input_ up to a full chunk once half of it is inflated,
+  // false once the file is exhausted
+  bool Read();
+
+  // starts inflating the next chunk, nothing is started at the end of input
+  void Submit();
+
+  // waits for the started work and drops the consumed input
+  std::string Collect();
+
+  void OpenStream();
+
+  Inflated InflateStep();
+
+  int fd_;
+  bool is_eof_;
+  bool is_plain_;
+  std::string input_;  // compressed bytes, inflated up to begin_
+  std::uint64_t begin_;
+  std::shared_ptr<thread_pool::ThreadPool> thread_pool_;
+  std::vector<std::pair<std::uint64_t, std::future<Inflated>>> members_;
+  std::future<Inflated> step_;
+  std::unique_ptr<z_stream> stream_;  // member inflated step by step
+};
+
+}  // namespace util
+}  // namespace raven
+
+#endif  // RAVEN_DECOMPRESSOR_HPP_
@@ -0,0 +1,45 @@
+#include "disjoint_sets.hpp"
+
+#include <utility>
+
+namespace raven {
+
+DisjointSets::DisjointSets(std::uint32_t size)
+    : parents_(size) {
+  for (std::uint32_t i = 0; i < size; ++i) {
+    parents_[i] = i;
+  }
+}
+
+std::uint32_t DisjointSets::Find(std::uint32_t id) {
+  while (true) {
+    auto parent = parents_[id].load();
+    if (parent == id) {
+      return id;
+    }
+    auto grandparent = parents_[parent].load();
+    if (parent != grandparent) {
+      parents_[id].compare_exchange_weak(parent, grandparent);
+    }
+    id = grandparent;
+  }
+}
+
+void DisjointSets::Union(std::uint32_t lhs, std::uint32_t rhs) {
+  while (true) {
+    lhs = Find(lhs);
+    rhs = Find(rhs);
+    if (lhs == rhs) {
+      return;
+    }
+    if (lhs < rhs) {
+      std::swap(lhs, rhs);
+    }
+    auto root = lhs;  // might have been linked meanwhile
+    if (parents_[lhs].compare_exchange_strong(root, rhs)) {
+      return;
+    }
+  }
+}
+
+}  // namespace raven
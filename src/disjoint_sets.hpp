@@ -0,0 +1,48 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_DISJOINT_SETS_HPP_
+#define RAVEN_DISJOINT_SETS_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace raven {
+
+// union-find over ids [0, size), Find and Union can be called concurrently as
+// parents are changed with compare-and-swap only (path halving, the larger
+// root is linked under the smaller one); sets can only be merged, a set split
+// by removed links is rebuilt by resetting all of its members
+class DisjointSets {
+ public:
+  explicit DisjointSets(std::uint32_t size = 0);
+
+  DisjointSets(const DisjointSets&) = delete;
+  DisjointSets& operator=(const DisjointSets&) = delete;
+
+  DisjointSets(DisjointSets&&) = default;
+  DisjointSets& operator=(DisjointSets&&) = default;
+
+  ~DisjointSets() = default;
+
+  std::uint32_t size() const {
+    return parents_.size();
+  }
+
+  // smallest id of the set of id
+  std::uint32_t Find(std::uint32_t id);
+
+  void Union(std::uint32_t lhs, std::uint32_t rhs);
+
+  // makes id a set of its own, no other member of its set can be in use
+  void Reset(std::uint32_t id) {
+    parents_[id] = id;
+  }
+
+ private:
+  std::vector<std::atomic<std::uint32_t>> parents_;
+};
+
+}  // namespace raven
+
+#endif  // RAVEN_DISJOINT_SETS_HPP_
@@ -13,6 +13,10 @@
 #include <numeric>
 #include <random>
 #include <deque>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
 
 #include <assert.h>  // TODO: Remove after dev
 
@@ -22,6 +26,8 @@
 #include "biosoup/timer.hpp"
 
 #include "common.hpp"
+#include "disjoint_sets.hpp"
+#include "writer.hpp"
 
 namespace raven {
 
@@ -156,32 +162,6 @@ bool OverlapFinalize(std::vector<std::unique_ptr<Pile>>& piles,
   return true;
 }
 
-// prerequsite, sequence id corresponds to pile id
-void StoreValidRegions(
-    std::vector<std::unique_ptr<Pile>>& piles,
-    std::vector<std::unique_ptr<biosoup::Sequence>>& sequences) {
-  std::size_t cnt = 0;
-  std::ofstream os(constants::kFillerSeqsPath);
-
-  for (auto const& seq : sequences) {
-    auto const& pile = piles[seq->id];
-
-    auto const pos = pile->begin();
-    auto const len = pile->length();
-
-    if (len >= constants::kMinSequenceLen) {
-      auto const valid_subsequence = seq->data.substr(pos, len);
-      ++cnt;
-
-      os << ">nc" + std::to_string(seq->id) << '\n'
-         << valid_subsequence << '\n';
-    }
-  }
-
-  std::cerr << "[raven::Graph::detail::StoreValidRegions] saved " << cnt
-            << " sequence regions" << std::endl;
-}
-
 enum class OverlapSide : std::uint8_t { kLeft, kRight };
 
 // assumes that sequence id corresponds to ovlp.lhs_id
@@ -239,6 +219,146 @@ enum class OverlapCategory { kIrrelevant, kLeft, kRight };
 
 enum class ExpandDir { kLeft, kRight };
 
+// ends of consecutive batches of [begin, end) with at least batch_bytes bases
+// each (but the last one)
+std::vector<std::uint32_t> BatchEnds(
+    std::uint32_t begin, std::uint32_t end,
+    const std::function<std::size_t(std::uint32_t)>& length,
+    std::size_t batch_bytes) {
+  std::vector<std::uint32_t> dst;
+  std::size_t bytes = 0;
+  for (auto i = begin; i < end; ++i) {
+    bytes += length(i);
+    if (i + 1 != end && bytes < batch_bytes) {
+      continue;
+    }
+    bytes = 0;
+    dst.emplace_back(i + 1);
+  }
+  return dst;
+}
+
+// reads [begin, end) mapped on the thread pool without blocking the caller,
+// one task per thread maps a chunk of reads into the sink of the chunk and
+// resubmits itself, so tasks submitted meanwhile run in between chunks instead
+// of after the whole batch; Get waits and returns sinks in the order of reads,
+// or rethrows the first exception thrown while mapping
+class MappingBatch {
+ public:
+  using Map = std::function<std::vector<biosoup::Overlap>(std::uint32_t)>;
+
+  MappingBatch(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+               std::uint32_t begin, std::uint32_t end, const Map& map)
+      : thread_pool_(thread_pool),
+        begin_(begin),
+        end_(end),
+        map_(map),
+        sinks_((end - begin + kChunkLen - 1) / kChunkLen),
+        next_chunk_(0),
+        num_tasks_(0),
+        mutex_(),
+        is_done_(),
+        exception_() {
+    std::uint32_t num_workers =
+        std::min<std::size_t>(thread_pool_->num_threads(), sinks_.size());
+    for (std::uint32_t i = 0; i < num_workers; ++i) {
+      Submit();
+    }
+  }
+
+  MappingBatch(const MappingBatch&) = delete;
+  MappingBatch& operator=(const MappingBatch&) = delete;
+
+  ~MappingBatch() {
+    Wait();
+  }
+
+  std::vector<std::vector<biosoup::Overlap>> Get() {
+    Wait();
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+    return std::move(sinks_);
+  }
+
+ private:
+  static std::uint32_t constexpr kChunkLen = 64;
+
+  void Submit() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++num_tasks_;
+    }
+    thread_pool_->Submit([&]() -> void { Work(); });  // tracked by num_tasks_
+  }
+
+  void Work() {
+    auto c = next_chunk_++;
+    if (c < sinks_.size()) {
+      try {
+        auto& sink = sinks_[c];
+        auto chunk_end = std::min(end_, begin_ + (c + 1) * kChunkLen);
+        for (auto i = begin_ + c * kChunkLen; i < chunk_end; ++i) {
+          auto overlaps = map_(i);
+          sink.insert(sink.end(), overlaps.begin(), overlaps.end());
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!exception_) {
+          exception_ = std::current_exception();
+        }
+      }
+      if (next_chunk_ < sinks_.size()) {
+        Submit();
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--num_tasks_ == 0) {
+      is_done_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_done_.wait(lock, [&]() -> bool { return num_tasks_ == 0; });
+  }
+
+  std::shared_ptr<thread_pool::ThreadPool> thread_pool_;
+  std::uint32_t begin_;
+  std::uint32_t end_;
+  Map map_;
+  std::vector<std::vector<biosoup::Overlap>> sinks_;
+  std::atomic<std::uint32_t> next_chunk_;
+  std::uint32_t num_tasks_;
+  std::mutex mutex_;
+  std::condition_variable is_done_;
+  std::exception_ptr exception_;
+};
+
+// maps batches [begin, batch_ends[0]), [batch_ends[0], batch_ends[1]), ...
+// and hands their overlaps to take in order; the next batch is mapped while
+// take handles the current one, tasks take submits to the pool run between
+// chunks of the next batch, so the pool does not drain between batches and at
+// most two batches are held at once
+void MapPipelined(
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+    std::uint32_t begin, const std::vector<std::uint32_t>& batch_ends,
+    const MappingBatch::Map& map,
+    const std::function<void(std::vector<std::vector<biosoup::Overlap>>&&)>&
+        take) {
+  std::unique_ptr<MappingBatch> next;
+  for (std::uint32_t i = 0; i < batch_ends.size(); ++i) {
+    if (!next) {
+      next.reset(new MappingBatch(thread_pool, begin, batch_ends[i], map));
+    }
+    auto mapped = next->Get();
+    next.reset(i + 1 < batch_ends.size()
+        ? new MappingBatch(thread_pool, batch_ends[i], batch_ends[i + 1], map)
+        : nullptr);
+    take(std::move(mapped));
+  }
+}
+
 }  // namespace detail
 
 Graph::Node::Node(const biosoup::Sequence& sequence)
@@ -253,6 +373,18 @@ Graph::Node::Node(const biosoup::Sequence& sequence)
       outedges(),
       pair() {}
 
+Graph::Node::Node(const std::string& name, PackedSequence data)
+    : id(num_objects++),
+      name(name),
+      data(std::move(data)),
+      count(1),
+      is_circular(),
+      is_polished(),
+      transitive(),
+      inedges(),
+      outedges(),
+      pair() {}
+
 Graph::Node::Node(Node* begin, Node* end)
     : id(num_objects++),
       name(),
@@ -266,14 +398,14 @@ Graph::Node::Node(Node* begin, Node* end)
       pair() {
   auto it = begin;
   while (true) {
-    data += it->outedges.front()->Label();
+    data.Append(it->data, 0, it->outedges.front()->length);
     count += it->count;
     if ((it = it->outedges.front()->head) == end) {
       break;
     }
   }
   if (begin != end) {
-    data += end->data;
+    data.Append(end->data);
     count += end->count;
   }
 
@@ -297,7 +429,10 @@ std::atomic<std::uint32_t> Graph::Edge::num_objects{0};
 Graph::Graph(bool weaken, std::shared_ptr<thread_pool::ThreadPool> thread_pool)
     : thread_pool_(thread_pool ? thread_pool
                                : std::make_shared<thread_pool::ThreadPool>(1)),
-      minimizer_engine_(weaken ? 29 : 15, weaken ? 9 : 5, thread_pool_),
+      kmer_len_(weaken ? 29 : 15),
+      window_len_(weaken ? 9 : 5),
+      minimizer_engine_(kmer_len_, window_len_, thread_pool_),
+      planner_(0, window_len_),
       stage_(-5),
       piles_(),
       nodes_(),
@@ -311,12 +446,17 @@ std::vector<std::unique_ptr<biosoup::Sequence>> Graph::Preprocess(
   biosoup::Timer timer{};
   std::vector<std::vector<biosoup::Overlap>> overlaps{};
 
+  std::uint64_t resident_bytes = 0;  // bases and qualities
+  for (const auto& it : sequences) {
+    resident_bytes += it->data.size() + it->quality.size();
+  }
+  auto const index_bases = planner_.IndexBases(resident_bytes, false);
+
   timer.Start();
   std::size_t sequence_batch_bytes = 0;
   for (std::size_t j = 0, i = 0; i < sequences.size(); ++i) {
     sequence_batch_bytes += sequences[i]->data.size();
-    if (i + 1 != sequences.size() &&
-        sequence_batch_bytes < constants::kSeqsBatchLim) {
+    if (i + 1 != sequences.size() && sequence_batch_bytes < index_bases) {
       continue;
     }
 
@@ -339,7 +479,7 @@ std::vector<std::unique_ptr<biosoup::Sequence>> Graph::Preprocess(
           k));
 
       overlap_batch_bytes += sequences[i]->data.size();
-      if (k != i && overlap_batch_bytes < constants::kOvlpBatchLim) {
+      if (k != i && overlap_batch_bytes < planner_.MappingBases()) {
         continue;
       }
 
@@ -360,19 +500,50 @@ std::vector<std::unique_ptr<biosoup::Sequence>> Graph::Preprocess(
 }
 
 void Graph::Construct(
-    std::vector<std::unique_ptr<biosoup::Sequence>>& sequences) {  // NOLINT
-
-  if (sequences.empty() || stage_ > -4) {
+    PackedSequences& sequences,  // NOLINT
+    util::SequenceStream* stream) {
+  if ((sequences.empty() && stream == nullptr) || stage_ > -4) {
     return;
   }
 
-  std::vector<std::vector<biosoup::Overlap>> overlaps(sequences.size());
+  std::unique_ptr<OverlapCache> cache;  // replayed instead of mapping
+  auto use_cache = !overlap_cache_path_.empty() && overlaps_path_.empty();
+  if (use_cache) {
+    cache = OverlapCache::Open(
+        overlap_cache_path_,
+        OverlapCache::Key(inputs_, kmer_len_, window_len_));
+  }
+
+  // piles exist or overlaps name any read, everything is needed upfront
+  if (stream && (stage_ > -5 || !overlaps_path_.empty() || cache)) {
+    while (true) {
+      auto batch = stream->Next();
+      if (batch.empty()) {
+        break;
+      }
+      sequences.Append(std::move(batch));
+    }
+    stream = nullptr;
+  }
+
+  if (cache && cache->reads_key() != OverlapCache::ReadsKey(sequences)) {
+    std::cerr << "[raven::Graph::Construct] warning: reads differ from "
+              << overlap_cache_path_ << ", mapping again" << std::endl;
+    cache.reset();
+  }
+
+  std::unique_ptr<OverlapCacheWriter> cache_writer;  // of a complete mapping
+  if (use_cache && !cache && stage_ == -5) {
+    cache_writer.reset(new OverlapCacheWriter(
+        overlap_cache_path_,
+        OverlapCache::Key(inputs_, kmer_len_, window_len_)));
+  }
+  auto is_mapping = overlaps_path_.empty() && !cache;
+
+  OverlapStore overlaps;  // of each read
+  OverlapSpill valid_overlaps(spill_dir_, spill_limit_);  // between valid reads
 
   // biosoup::Overlap helper functions
-  auto overlap_reverse = [](const biosoup::Overlap& o) -> biosoup::Overlap {
-    return biosoup::Overlap(o.rhs_id, o.rhs_begin, o.rhs_end, o.lhs_id,
-                            o.lhs_begin, o.lhs_end, o.score, o.strand);
-  };
   auto overlap_length = [](const biosoup::Overlap& o) -> std::uint32_t {
     return std::max(o.rhs_end - o.rhs_begin, o.lhs_end - o.lhs_begin);
   };
@@ -389,41 +560,87 @@ void Graph::Construct(
     return detail::OverlapFinalize(piles_, o);
   };
 
-  auto connected_components =
-      [&]() -> std::vector<std::vector<std::uint32_t>> {  // NOLINT
-    std::vector<std::vector<std::uint32_t>> connections(sequences.size());
-    for (const auto& it : overlaps) {
-      for (const auto& jt : it) {
-        if (overlap_type(jt) > 2) {
-          connections[jt.lhs_id].emplace_back(jt.rhs_id);
-          connections[jt.rhs_id].emplace_back(jt.lhs_id);
-        }
-      }
+  // marks reads which share a set of components with any of ids
+  auto component_members = [&](DisjointSets& components,
+                               const std::vector<std::uint32_t>& ids)
+      -> std::vector<char> {
+    std::vector<char> is_root(components.size(), 0);
+    for (const auto& it : ids) {
+      is_root[components.Find(it)] = 1;
+    }
+    std::vector<char> dst(components.size(), 0);
+    util::ParallelFor(thread_pool_, components.size(),
+        [&](std::uint32_t begin, std::uint32_t end) -> void {
+          for (auto i = begin; i < end; ++i) {
+            dst[i] = is_root[components.Find(i)];
+          }
+        });
+    return dst;
+  };
+
+  // joins reads by overlaps of type 3 or 4 into components, which can only
+  // split as overlaps are removed; reads sharing a component with any of ids
+  // are regrouped (all reads if components are empty) and the new components
+  // of them with a valid read are returned, the others are left as they were
+  auto connected_components = [&](DisjointSets& components,
+                                  const std::vector<std::uint32_t>& ids)
+      -> std::vector<std::vector<std::uint32_t>> {  // NOLINT
+    std::vector<char> is_member;
+    if (components.size() != sequences.size()) {
+      components = DisjointSets(sequences.size());
+      is_member.resize(sequences.size(), 1);
+    } else {
+      is_member = component_members(components, ids);
+      util::ParallelFor(thread_pool_, components.size(),
+          [&](std::uint32_t begin, std::uint32_t end) -> void {
+            for (auto i = begin; i < end; ++i) {
+              if (is_member[i]) {
+                components.Reset(i);
+              }
+            }
+          });
     }
 
+    auto connect = [&](const biosoup::Overlap& o) -> void {
+      if ((is_member[o.lhs_id] || is_member[o.rhs_id]) &&
+          overlap_type(o) > 2) {
+        components.Union(o.lhs_id, o.rhs_id);
+      }
+    };
+    util::ParallelFor(thread_pool_, overlaps.num_reads(),
+        [&](std::uint32_t begin, std::uint32_t end) -> void {
+          for (auto i = begin; i < end; ++i) {
+            if (!is_member[i]) {
+              continue;
+            }
+            for (std::uint32_t j = 0; j < overlaps.size(i); ++j) {
+              connect(overlaps.Get(i, j));
+            }
+          }
+        });
+    valid_overlaps.ForEach(connect);
+
+    std::vector<char> is_valid(sequences.size(), 0);  // of roots
+    for (std::uint32_t i = 0; i < sequences.size(); ++i) {
+      if (is_member[i] && !piles_[i]->is_invalid()) {
+        is_valid[components.Find(i)] = 1;
+      }
+    }
     std::vector<std::vector<std::uint32_t>> dst;
-    std::vector<char> is_visited(sequences.size(), false);
-    for (std::uint32_t i = 0; i < connections.size(); ++i) {
-      if (piles_[i]->is_invalid() || is_visited[i]) {
+    std::vector<std::uint32_t> component_ids(sequences.size(), -1);  // of roots
+    for (std::uint32_t i = 0; i < sequences.size(); ++i) {
+      if (!is_member[i]) {
         continue;
       }
-
-      dst.resize(dst.size() + 1);
-      std::deque<std::uint32_t> que = {i};
-      while (!que.empty()) {
-        std::uint32_t j = que.front();
-        que.pop_front();
-
-        if (is_visited[j]) {
-          continue;
-        }
-        is_visited[j] = true;
-        dst.back().emplace_back(j);
-
-        for (const auto& it : connections[j]) {
-          que.emplace_back(it);
-        }
+      auto root = components.Find(i);
+      if (!is_valid[root]) {
+        continue;
+      }
+      if (component_ids[root] == static_cast<std::uint32_t>(-1)) {
+        component_ids[root] = dst.size();
+        dst.emplace_back();
       }
+      dst[component_ids[root]].emplace_back(i);
     }
 
     return dst;
@@ -436,100 +653,163 @@ void Graph::Construct(
 
   biosoup::Timer timer{};
 
-  if (stage_ == -5) {  // find overlaps and create piles
-    for (const auto& it : sequences) {
-      piles_.emplace_back(new Pile(it->id, it->data.size()));
+  // memory held by reads as they are stored (packed, evicted ones without
+  // bases), their piles and overlaps kept per read; streamed reads are counted
+  // once they are parsed
+  auto resident_bytes = [&]() -> std::uint64_t {
+    std::uint64_t dst = sequences.bytes() + overlaps.bytes();
+    for (std::uint32_t i = 0; i < sequences.size(); ++i) {
+      dst += (sequences.length(i) >> kPSS) * sizeof(std::uint32_t);  // pile
+    }
+    return dst;
+  };
+  auto const minhash_bases = planner_.IndexBases(resident_bytes(), true);
+  auto const mapping_bases = planner_.MappingBases();
+
+  // returns the end of the next minimization batch starting at begin,
+  // pulling its sequences from the stream when there is one
+  auto next_batch = [&](std::uint32_t begin) -> std::uint32_t {
+    if (stream) {
+      sequences.Append(stream->Next());
+      return sequences.size();
     }
     std::size_t bytes = 0;
-    for (std::uint32_t i = 0, j = 0; i < sequences.size(); ++i) {
-      bytes += sequences[i]->data.size();
-      if (i != sequences.size() - 1 && bytes < constants::kSeqsBatchLim) {
-        continue;
+    std::uint32_t end = begin;
+    while (end < sequences.size() && bytes < minhash_bases) {
+      bytes += sequences.length(end++);
+    }
+    return end;
+  };
+
+  if (stage_ == -5) {  // find overlaps and create piles
+    OverlapReservoir longest(16);  // overlaps of each read
+
+    // adds overlaps of a batch to piles and keeps the longest ones, the
+    // batch is grouped by read and dropped
+    auto layer_overlaps = [&](
+        const std::vector<std::vector<biosoup::Overlap>>& mapped) -> void {
+      overlaps.Assign(mapped, sequences.size(), thread_pool_);
+      longest.Resize(sequences.size());
+
+      std::vector<std::future<void>> void_futures;
+      for (const auto& it : piles_) {
+        if (overlaps.size(it->id()) == 0) {
+          continue;
+        }
+
+        void_futures.emplace_back(thread_pool_->Submit(
+            [&](std::uint32_t i) -> void {
+              auto layers = overlaps.Unpack(i);
+              piles_[i]->AddLayers(layers.begin(), layers.end());
+              for (const auto& jt : layers) {
+                longest.Push(i, jt);
+              }
+            },
+            it->id()));
       }
-      bytes = 0;
+      for (const auto& it : void_futures) {
+        it.wait();
+      }
+      overlaps.Clear();
+    };
 
+    if (cache) {
       timer.Start();
 
-      minimizer_engine_.Minimize(sequences.begin() + j,
-                                 sequences.begin() + i + 1, true);
-      minimizer_engine_.Filter(constants::kKMerDiscardFreqHard);
-
-      std::cerr << "[raven::Graph::Construct] minimized " << j << " - " << i + 1
-                << " / " << sequences.size() << " " << std::fixed
-                << timer.Stop() << "s" << std::endl;
+      for (std::uint32_t k = 0; k < sequences.size(); ++k) {
+        piles_.emplace_back(new Pile(k, sequences.length(k)));
+      }
+      for (std::uint64_t i = 0; i < cache->num_batches(OverlapCache::kPiles);
+           ++i) {
+        std::vector<std::vector<biosoup::Overlap>> mapped;
+        mapped.emplace_back(cache->Batch(OverlapCache::kPiles, i));
+        layer_overlaps(mapped);
+      }
 
+      std::cerr << "[raven::Graph::Construct] loaded cached overlaps from "
+                << overlap_cache_path_ << " " << std::fixed << timer.Stop()
+                << "s" << std::endl;
+    } else if (!overlaps_path_.empty()) {
       timer.Start();
 
-      std::vector<std::uint32_t> num_overlaps(overlaps.size());
-      for (std::uint32_t k = 0; k < overlaps.size(); ++k) {
-        num_overlaps[k] = overlaps[k].size();
+      for (std::uint32_t k = 0; k < sequences.size(); ++k) {
+        piles_.emplace_back(new Pile(k, sequences.length(k)));
       }
+      util::LoadOverlaps(overlaps_path_, sequences, thread_pool_,
+          [&](std::vector<biosoup::Overlap>&& batch) -> void {
+            std::vector<std::vector<biosoup::Overlap>> mapped;
+            mapped.emplace_back(std::move(batch));
+            layer_overlaps(mapped);
+          });
 
-      std::vector<std::future<std::vector<biosoup::Overlap>>> thread_futures;
+      std::cerr << "[raven::Graph::Construct] loaded overlaps from "
+                << overlaps_path_ << " " << std::fixed << timer.Stop() << "s"
+                << std::endl;
+    }
 
-      for (std::uint32_t k = 0; k < i + 1; ++k) {
-        thread_futures.emplace_back(thread_pool_->Submit(
-            [&](std::uint32_t i) -> std::vector<biosoup::Overlap> {
-              return minimizer_engine_.Map(sequences[i], true, true, true);
-            },
-            k));
+    auto length = [&](std::uint32_t k) -> std::size_t {
+      return sequences.length(k);
+    };
+    for (std::uint32_t i = 0, j = 0; is_mapping; j = i + 1) {
+      timer.Start();
 
-        bytes += sequences[k]->data.size();
-        if (k != i && bytes < (1U << 30)) {
-          continue;
-        }
-        bytes = 0;
+      auto batch_end = next_batch(j);
+      if (batch_end == j) {
+        break;
+      }
+      i = batch_end - 1;
 
-        for (auto& it : thread_futures) {
-          for (const auto& jt : it.get()) {
-            overlaps[jt.lhs_id].emplace_back(jt);
-            overlaps[jt.rhs_id].emplace_back(overlap_reverse(jt));
-          }
-        }
-        thread_futures.clear();
+      for (std::uint32_t k = j; k < i + 1; ++k) {
+        piles_.emplace_back(new Pile(k, sequences.length(k)));
+      }
 
-        std::vector<std::future<void>> void_futures;
-        for (const auto& it : piles_) {
-          if (overlaps[it->id()].empty() ||
-              overlaps[it->id()].size() == num_overlaps[it->id()]) {
-            continue;
-          }
+      if (stream) {
+        std::cerr << "[raven::Graph::Construct] loaded " << j << " - " << i + 1
+                  << " sequences " << std::fixed << timer.Stop() << "s"
+                  << std::endl;
 
-          void_futures.emplace_back(thread_pool_->Submit(
-              [&](std::uint32_t i) -> void {
-                piles_[i]->AddLayers(overlaps[i].begin() + num_overlaps[i],
-                                     overlaps[i].end());
+        timer.Start();
+      }
 
-                num_overlaps[i] =
-                    std::min(overlaps[i].size(), static_cast<std::size_t>(16));
+      {
+        auto batch = sequences.UnpackBases(j, i + 1);
+        minimizer_engine_.Minimize(batch.begin(), batch.end(), true);
+        minimizer_engine_.Filter(constants::kKMerDiscardFreqHard);
+      }
 
-                if (overlaps[i].size() < 16) {
-                  return;
-                }
+      std::cerr << "[raven::Graph::Construct] minimized " << j << " - " << i + 1
+                << " / " << sequences.size() << " " << std::fixed
+                << timer.Stop() << "s" << std::endl;
 
-                std::sort(overlaps[i].begin(), overlaps[i].end(),
-                          [&](const biosoup::Overlap& lhs,
-                              const biosoup::Overlap& rhs) -> bool {
-                            return overlap_length(lhs) > overlap_length(rhs);
-                          });
+      timer.Start();
 
-                std::vector<biosoup::Overlap> tmp;
-                tmp.insert(tmp.end(), overlaps[i].begin(),
-                           overlaps[i].begin() + 16);  // NOLINT
-                tmp.swap(overlaps[i]);
-              },
-              it->id()));
-        }
-        for (const auto& it : void_futures) {
-          it.wait();
-        }
-      }
+      detail::MapPipelined(thread_pool_, 0,
+          detail::BatchEnds(0, i + 1, length, mapping_bases),
+          [&](std::uint32_t k) -> std::vector<biosoup::Overlap> {
+            return minimizer_engine_.Map(sequences.UnpackBases(k), true, true,
+                                         true);
+          },
+          [&](std::vector<std::vector<biosoup::Overlap>>&& mapped) -> void {
+            if (cache_writer) {
+              cache_writer->Write(OverlapCache::kPiles, mapped);
+            }
+            layer_overlaps(mapped);
+          });
 
       std::cerr << "[raven::Graph::Construct] mapped sequences " << std::fixed
                 << timer.Stop() << "s" << std::endl;
-
-      j = i + 1;
     }
+
+    longest.Resize(sequences.size());
+    overlaps.Assign(longest.num_reads(),
+        [&](std::uint32_t i) -> std::uint32_t {
+          return longest.size(i);
+        },
+        [&](std::uint32_t i) -> std::vector<biosoup::Overlap> {
+          return longest.Unpack(i);
+        },
+        thread_pool_);
+    longest.Clear();
   }
 
   if (stage_ == -5) {  // trim and annotate piles
@@ -541,7 +821,7 @@ void Graph::Construct(
           [&](std::uint32_t i) -> void {
             piles_[i]->FindValidRegion(4);
             if (piles_[i]->is_invalid()) {
-              std::vector<biosoup::Overlap>().swap(overlaps[i]);
+              overlaps.Clear(i);
             } else {
               piles_[i]->FindMedian();
               piles_[i]->FindChimericRegions();
@@ -561,27 +841,31 @@ void Graph::Construct(
   if (stage_ == -5) {  // resolve contained reads
     timer.Start();
 
-    for (std::uint32_t i = 0; i < overlaps.size(); ++i) {
-      std::uint32_t k = 0;
-      for (std::uint32_t j = 0; j < overlaps[i].size(); ++j) {
-        if (!overlap_update(overlaps[i][j])) {
-          continue;
-        }
-        std::uint32_t type = overlap_type(overlaps[i][j]);
-        if (type == 1 && !piles_[overlaps[i][j].rhs_id]->is_maybe_chimeric()) {
-          piles_[i]->set_is_contained();
-        } else if (type == 2 && !piles_[i]->is_maybe_chimeric()) {
-          piles_[overlaps[i][j].rhs_id]->set_is_contained();
-        } else {
-          overlaps[i][k++] = overlaps[i][j];
-        }
-      }
-      overlaps[i].resize(k);
-    }
+    // set while reads are filtered concurrently, moved to piles afterwards
+    std::vector<std::atomic<bool>> is_contained(piles_.size());
+    overlaps.Filter(
+        [&](biosoup::Overlap& o) -> bool {
+          if (!overlap_update(o)) {
+            return false;
+          }
+          std::uint32_t type = overlap_type(o);
+          if (type == 1 && !piles_[o.rhs_id]->is_maybe_chimeric()) {
+            is_contained[o.lhs_id] = true;
+          } else if (type == 2 && !piles_[o.lhs_id]->is_maybe_chimeric()) {
+            is_contained[o.rhs_id] = true;
+          } else {
+            return true;
+          }
+          return false;
+        },
+        thread_pool_);
     for (std::uint32_t i = 0; i < piles_.size(); ++i) {
+      if (is_contained[i]) {
+        piles_[i]->set_is_contained();
+      }
       if (piles_[i]->is_contained()) {
         piles_[i]->set_is_invalid();
-        std::vector<biosoup::Overlap>().swap(overlaps[i]);
+        overlaps.Clear(i);
       }
     }
 
@@ -592,8 +876,14 @@ void Graph::Construct(
   if (stage_ == -5) {  // resolve chimeric sequences
     timer.Start();
 
+    // only components with changed reads are regrouped and resolved again,
+    // the others would end up the same
+    DisjointSets components_of;
+    std::vector<std::uint32_t> changed_ids;
     while (true) {
-      auto components = connected_components();
+      auto components = connected_components(components_of, changed_ids);
+
+      std::vector<char> is_changed_pile(piles_.size(), 0);
       for (const auto& it : components) {
         std::vector<std::uint32_t> medians;
         for (const auto& jt : it) {
@@ -607,10 +897,16 @@ void Graph::Construct(
         for (const auto& jt : it) {
           thread_futures.emplace_back(thread_pool_->Submit(
               [&](std::uint32_t i) -> void {
+                auto begin = piles_[i]->begin();
+                auto end = piles_[i]->end();
+                auto is_invalid = piles_[i]->is_invalid();
                 piles_[i]->ClearChimericRegions(median);
                 if (piles_[i]->is_invalid()) {
-                  std::vector<biosoup::Overlap>().swap(overlaps[i]);
+                  overlaps.Clear(i);
                 }
+                is_changed_pile[i] = begin != piles_[i]->begin() ||
+                                     end != piles_[i]->end() ||
+                                     is_invalid != piles_[i]->is_invalid();
               },
               jt));
         }
@@ -620,33 +916,56 @@ void Graph::Construct(
         thread_futures.clear();
       }
 
-      bool is_changed = false;
-      for (std::uint32_t i = 0; i < overlaps.size(); ++i) {
-        std::uint32_t k = 0;
-        for (std::uint32_t j = 0; j < overlaps[i].size(); ++j) {
-          if (overlap_update(overlaps[i][j])) {
-            overlaps[i][k++] = overlaps[i][j];
-          } else {
-            is_changed = true;
-          }
+      // overlaps of changed piles can change type or be removed, both of
+      // their reads are regrouped; reads are filtered concurrently
+      std::atomic<bool> is_changed{false};
+      std::vector<std::atomic<bool>> is_changed_read(piles_.size());
+      overlaps.Filter(
+          [&](biosoup::Overlap& o) -> bool {
+            bool is_kept = overlap_update(o);
+            if (!is_kept ||
+                is_changed_pile[o.lhs_id] || is_changed_pile[o.rhs_id]) {
+              is_changed_read[o.lhs_id] = true;
+              is_changed_read[o.rhs_id] = true;
+            }
+            if (!is_kept) {
+              is_changed = true;
+            }
+            return is_kept;
+          },
+          thread_pool_);
+
+      changed_ids.clear();
+      for (std::uint32_t i = 0; i < piles_.size(); ++i) {
+        if (is_changed_pile[i] || is_changed_read[i]) {
+          changed_ids.emplace_back(i);
         }
-        overlaps[i].resize(k);
       }
 
       if (!is_changed) {
-        for (const auto& it : overlaps) {
-          for (const auto& jt : it) {
-            std::uint32_t type = overlap_type(jt);
-            if (type == 1) {
-              piles_[jt.lhs_id]->set_is_contained();
-              piles_[jt.lhs_id]->set_is_invalid();
-            } else if (type == 2) {
-              piles_[jt.rhs_id]->set_is_contained();
-              piles_[jt.rhs_id]->set_is_invalid();
-            }
+        // set from concurrent tasks, moved to piles afterwards
+        std::vector<std::atomic<bool>> is_contained(piles_.size());
+        util::ParallelFor(thread_pool_, overlaps.num_reads(),
+            [&](std::uint32_t begin, std::uint32_t end) -> void {
+              for (auto i = begin; i < end; ++i) {
+                for (std::uint32_t j = 0; j < overlaps.size(i); ++j) {
+                  auto o = overlaps.Get(i, j);
+                  std::uint32_t type = overlap_type(o);
+                  if (type == 1) {
+                    is_contained[o.lhs_id] = true;
+                  } else if (type == 2) {
+                    is_contained[o.rhs_id] = true;
+                  }
+                }
+              }
+            });
+        for (std::uint32_t i = 0; i < piles_.size(); ++i) {
+          if (is_contained[i]) {
+            piles_[i]->set_is_contained();
+            piles_[i]->set_is_invalid();
           }
         }
-        overlaps.clear();
+        overlaps.Clear();
         break;
       }
     }
@@ -686,38 +1005,154 @@ void Graph::Construct(
   }
 
   if (stage_ == -4) {  // find overlaps and update piles with repetitive regions
-    std::sort(sequences.begin(), sequences.end(),
-              [&](const std::unique_ptr<biosoup::Sequence>& lhs,
-                  const std::unique_ptr<biosoup::Sequence>& rhs) -> bool {
-                return piles_[lhs->id]->is_invalid() <
-                           piles_[rhs->id]->is_invalid() ||  // NOLINT
-                       (piles_[lhs->id]->is_invalid() ==
-                            piles_[rhs->id]->is_invalid() &&
-                        lhs->id < rhs->id);  // NOLINT
-              });
+    // valid sequence ids followed by invalid ones
+    std::vector<std::uint32_t> ids;
+    ids.reserve(sequences.size());
+    for (const auto& it : piles_) {
+      if (!it->is_invalid()) {
+        ids.emplace_back(it->id());
+      }
+    }
+    std::uint32_t s = ids.size();
+    for (const auto& it : piles_) {
+      if (it->is_invalid()) {
+        ids.emplace_back(it->id());
+      }
+    }
+    auto id_length = [&](std::uint32_t k) -> std::size_t {
+      return sequences.length(ids[k]);
+    };
 
-    std::uint32_t s = 0;
-    for (std::uint32_t i = 0; i < sequences.size(); ++i) {
-      if (piles_[sequences[i]->id]->is_invalid()) {
-        s = i;
-        break;
+    // adds coverage of overlaps between invalid and valid reads to piles of
+    // valid reads, piles are locked in shards so that mapping workers can
+    // call it without storing the overlaps (safe to call from workers)
+    std::vector<std::mutex> pile_locks(1024);
+    auto layer_overlaps = [&](const std::vector<biosoup::Overlap>& overlaps)
+        -> void {
+      for (const auto& it : overlaps) {
+        auto id = piles_[it.lhs_id]->is_invalid() ? it.rhs_id : it.lhs_id;
+        std::lock_guard<std::mutex> lock(pile_locks[id % pile_locks.size()]);
+        piles_[id]->AddLayer(it);
+      }
+    };
+
+    // set from mapping workers, moved to piles once all overlaps are in
+    std::vector<std::atomic<bool>> is_contained(piles_.size());
+
+    // updates overlaps between valid reads and stores their type as score,
+    // marks contained reads and drops overlaps of other types, keeps the
+    // longest of consecutive overlaps of each pair; contained overlaps are
+    // kept with keep_contained (safe to call from workers)
+    auto classify_overlaps = [&](std::vector<biosoup::Overlap>& overlaps,
+                                 bool keep_contained) -> void {
+      std::size_t n = 0;
+      std::size_t last = -1;  // of type 3 or 4
+      for (auto& it : overlaps) {
+        if (!overlap_update(it)) {
+          continue;
+        }
+        it.score = overlap_type(it);
+        if (it.score == 0) {
+          continue;
+        } else if (it.score < 3) {
+          is_contained[it.score == 1 ? it.lhs_id : it.rhs_id] = true;
+          if (keep_contained) {
+            overlaps[n++] = it;
+          }
+        } else if (last != static_cast<std::size_t>(-1) &&
+                   overlaps[last].lhs_id == it.lhs_id &&
+                   overlaps[last].rhs_id == it.rhs_id) {
+          if (overlap_length(overlaps[last]) < overlap_length(it)) {
+            overlaps[last] = it;
+          }
+        } else {
+          last = n;
+          overlaps[n++] = it;
+        }
+      }
+      overlaps.resize(n);
+    };
+
+    // takes classified overlaps, keeps the longest overlap of each pair
+    auto add_valid_overlaps = [&](
+        const std::vector<biosoup::Overlap>& overlaps) -> void {
+      for (const auto& it : overlaps) {
+        if (it.score < 3) {
+          is_contained[it.score == 1 ? it.lhs_id : it.rhs_id] = true;
+        } else if (!valid_overlaps.empty() &&
+                   valid_overlaps.back().lhs_id == it.lhs_id &&
+                   valid_overlaps.back().rhs_id == it.rhs_id) {
+          if (overlap_length(valid_overlaps.back()) < overlap_length(it)) {
+            valid_overlaps.back() = it;
+          }
+        } else {
+          valid_overlaps.emplace_back(it);
+        }
       }
+    };
+
+    if (cache) {
+      timer.Start();
+
+      for (std::uint64_t i = 0; i < cache->num_batches(OverlapCache::kInvalid);
+           ++i) {
+        layer_overlaps(cache->Batch(OverlapCache::kInvalid, i));
+      }
+      for (std::uint64_t i = 0; i < cache->num_batches(OverlapCache::kValid);
+           ++i) {
+        add_valid_overlaps(cache->Batch(OverlapCache::kValid, i));
+      }
+
+      std::cerr << "[raven::Graph::Construct] loaded cached overlaps from "
+                << overlap_cache_path_ << " " << std::fixed << timer.Stop()
+                << "s" << std::endl;
+    } else if (!overlaps_path_.empty()) {
+      timer.Start();
+
+      util::LoadOverlaps(overlaps_path_, sequences, thread_pool_,
+          [&](std::vector<biosoup::Overlap>&& batch) -> void {
+            std::vector<biosoup::Overlap> valid;
+            std::vector<biosoup::Overlap> invalid;
+            for (const auto& it : batch) {
+              bool lhs_invalid = piles_[it.lhs_id]->is_invalid();
+              bool rhs_invalid = piles_[it.rhs_id]->is_invalid();
+              if (!lhs_invalid && !rhs_invalid) {
+                valid.emplace_back(it);
+              } else if (lhs_invalid != rhs_invalid) {
+                invalid.emplace_back(it);
+              }
+            }
+            layer_overlaps(invalid);
+            classify_overlaps(valid, false);
+            add_valid_overlaps(valid);
+          });
+
+      std::cerr << "[raven::Graph::Construct] loaded overlaps from "
+                << overlaps_path_ << " " << std::fixed << timer.Stop() << "s"
+                << std::endl;
     }
 
+    // all reads are in by now, streamed ones included
+    auto const invalid_index_bases =
+        planner_.IndexBases(resident_bytes(), true);
+    auto const valid_index_bases = planner_.IndexBases(resident_bytes(), false);
+
     // map invalid reads to valid reads
-    overlaps.resize(sequences.size() + 1);
     std::size_t bytes = 0;
-    for (std::uint32_t i = 0, j = 0; i < s; ++i) {
-      bytes += sequences[i]->data.size();
-      if (i != s - 1 && bytes < (1ULL << 32)) {
+    for (std::uint32_t i = 0, j = 0; is_mapping && i < s; ++i) {
+      bytes += sequences.length(ids[i]);
+      if (i != s - 1 && bytes < invalid_index_bases) {
         continue;
       }
       bytes = 0;
 
       timer.Start();
 
-      minimizer_engine_.Minimize(sequences.begin() + j,
-                                 sequences.begin() + i + 1, true);
+      {
+        auto batch = sequences.UnpackBases(ids.begin() + j,
+                                           ids.begin() + i + 1);
+        minimizer_engine_.Minimize(batch.begin(), batch.end(), true);
+      }
 
       std::cerr << "[raven::Graph::Construct] minimized " << j << " - " << i + 1
                 << " / " << s << " " << std::fixed << timer.Stop() << "s"
@@ -726,43 +1161,22 @@ void Graph::Construct(
       timer.Start();
 
       minimizer_engine_.Filter(constants::kMerDiscardFreqSoft);
-      std::vector<std::future<std::vector<biosoup::Overlap>>> thread_futures;
-      for (std::uint32_t k = s; k < sequences.size(); ++k) {
-        thread_futures.emplace_back(thread_pool_->Submit(
-            [&](std::uint32_t i) -> std::vector<biosoup::Overlap> {
-              return minimizer_engine_.Map(sequences[i], true, false, true);
-            },
-            k));
-
-        bytes += sequences[k]->data.size();
-        if (k != sequences.size() - 1 && bytes < (1U << 30)) {
-          continue;
-        }
-        bytes = 0;
-
-        for (auto& it : thread_futures) {
-          for (const auto& jt : it.get()) {
-            overlaps[jt.rhs_id].emplace_back(jt);
-          }
-        }
-        thread_futures.clear();
-
-        std::vector<std::future<void>> void_futures;
-        for (std::uint32_t k = j; k < i + 1; ++k) {
-          if (overlaps[sequences[k]->id].empty()) {
-            continue;
-          }
-          void_futures.emplace_back(thread_pool_->Submit(
-              [&](std::uint32_t i) -> void {
-                piles_[i]->AddLayers(overlaps[i].begin(), overlaps[i].end());
-                std::vector<biosoup::Overlap>().swap(overlaps[i]);
-              },
-              sequences[k]->id));
-        }
-        for (const auto& it : void_futures) {
-          it.wait();
-        }
-      }
+      detail::MapPipelined(thread_pool_, s,
+          detail::BatchEnds(s, ids.size(), id_length, mapping_bases),
+          [&](std::uint32_t k) -> std::vector<biosoup::Overlap> {
+            auto overlaps = minimizer_engine_.Map(
+                sequences.UnpackBases(ids[k]), true, false, true);
+            layer_overlaps(overlaps);
+            if (!cache_writer) {  // not needed anymore
+              overlaps.clear();
+            }
+            return overlaps;
+          },
+          [&](std::vector<std::vector<biosoup::Overlap>>&& mapped) -> void {
+            if (cache_writer) {
+              cache_writer->Write(OverlapCache::kInvalid, mapped);
+            }
+          });
 
       std::cerr << "[raven::Graph::Construct] mapped invalid sequences "
                 << std::fixed << timer.Stop() << "s" << std::endl;
@@ -770,19 +1184,26 @@ void Graph::Construct(
       j = i + 1;
     }
 
+    for (std::uint32_t k = s; k < ids.size(); ++k) {  // done with invalid reads
+      sequences.Evict(ids[k]);
+    }
+
     // map valid reads to each other
     bytes = 0;
-    for (std::uint32_t i = 0, j = 0; i < s; ++i) {
-      bytes += sequences[i]->data.size();
-      if (i != s - 1 && bytes < (1U << 30)) {
+    for (std::uint32_t i = 0, j = 0; is_mapping && i < s; ++i) {
+      bytes += sequences.length(ids[i]);
+      if (i != s - 1 && bytes < valid_index_bases) {
         continue;
       }
       bytes = 0;
 
       timer.Start();
 
-      minimizer_engine_.Minimize(sequences.begin() + j,
-                                 sequences.begin() + i + 1);
+      {
+        auto batch = sequences.UnpackBases(ids.begin() + j,
+                                           ids.begin() + i + 1);
+        minimizer_engine_.Minimize(batch.begin(), batch.end());
+      }
 
       std::cerr << "[raven::Graph::Construct] minimized " << j << " - " << i + 1
                 << " / " << s << " " << std::fixed << timer.Stop() << "s"
@@ -790,41 +1211,23 @@ void Graph::Construct(
 
       timer.Start();
 
-      std::vector<std::future<std::vector<biosoup::Overlap>>> thread_futures;
       minimizer_engine_.Filter(constants::kKMerDiscardFreqHard);
-      for (std::uint32_t k = 0; k < i + 1; ++k) {
-        thread_futures.emplace_back(thread_pool_->Submit(
-            [&](std::uint32_t i) -> std::vector<biosoup::Overlap> {
-              return minimizer_engine_.Map(sequences[i], true, true);
-            },
-            k));
-      }
-      for (auto& it : thread_futures) {
-        for (auto& jt : it.get()) {
-          if (!overlap_update(jt)) {
-            continue;
-          }
-          std::uint32_t type = overlap_type(jt);
-          if (type == 0) {
-            continue;
-          } else if (type == 1) {
-            piles_[jt.lhs_id]->set_is_contained();
-          } else if (type == 2) {
-            piles_[jt.rhs_id]->set_is_contained();
-          } else {
-            if (overlaps.back().size() &&
-                overlaps.back().back().lhs_id == jt.lhs_id &&
-                overlaps.back().back().rhs_id == jt.rhs_id) {
-              if (overlap_length(overlaps.back().back()) < overlap_length(jt)) {
-                overlaps.back().back() = jt;
+      detail::MapPipelined(thread_pool_, 0,
+          detail::BatchEnds(0, i + 1, id_length, mapping_bases),
+          [&](std::uint32_t k) -> std::vector<biosoup::Overlap> {
+            auto overlaps = minimizer_engine_.Map(
+                sequences.UnpackBases(ids[k]), true, true);
+            classify_overlaps(overlaps, cache_writer != nullptr);
+            return overlaps;
+          },
+          [&](std::vector<std::vector<biosoup::Overlap>>&& mapped) -> void {
+            for (const auto& it : mapped) {
+              if (cache_writer) {
+                cache_writer->Write(OverlapCache::kValid, it);
               }
-            } else {
-              overlaps.back().emplace_back(jt);
+              add_valid_overlaps(it);
             }
-          }
-        }
-      }
-      thread_futures.clear();
+          });
 
       std::cerr << "[raven::Graph::Construct] mapped valid sequences "
                 << std::fixed << timer.Stop() << "s" << std::endl;
@@ -832,6 +1235,30 @@ void Graph::Construct(
       j = i + 1;
     }
 
+    for (std::uint32_t i = 0; i < piles_.size(); ++i) {
+      if (is_contained[i]) {
+        piles_[i]->set_is_contained();
+      }
+    }
+
+    if (cache_writer) {
+      timer.Start();
+
+      cache_writer->Close(OverlapCache::ReadsKey(sequences));
+      cache_writer.reset();
+
+      std::cerr << "[raven::Graph::Construct] cached overlaps in "
+                << overlap_cache_path_ << " " << std::fixed << timer.Stop()
+                << "s" << std::endl;
+    }
+
+    if (valid_overlaps.num_spilled() > 0) {
+      std::cerr << "[raven::Graph::Construct] spilled "
+                << valid_overlaps.num_spilled() << " / "
+                << valid_overlaps.size() << " overlaps to " << spill_dir_
+                << std::endl;
+    }
+
     timer.Start();
 
     std::vector<std::future<void>> thread_futures;
@@ -860,31 +1287,29 @@ void Graph::Construct(
 
     timer.Start();
 
-    {
-      std::uint32_t k = 0;
-      for (std::uint32_t i = 0; i < overlaps.back().size(); ++i) {
-        if (overlap_update(overlaps.back()[i])) {
-          overlaps.back()[k++] = overlaps.back()[i];
-        }
-      }
-      overlaps.back().resize(k);
-    }
+    valid_overlaps.Filter(overlap_update, thread_pool_);
 
     std::cerr << "[raven::Graph::Construct] updated overlaps " << std::fixed
               << timer.Stop() << "s" << std::endl;
-
-    std::sort(sequences.begin(), sequences.end(),
-              [&](const std::unique_ptr<biosoup::Sequence>& lhs,
-                  const std::unique_ptr<biosoup::Sequence>& rhs) -> bool {
-                return lhs->id < rhs->id;
-              });
   }
 
   if (stage_ == -4) {  // resolve repeat induced overlaps
     timer.Start();
 
+    // only components with removed overlaps are regrouped and searched for
+    // repeats again, the others would end up the same
+    DisjointSets components_of;
+    std::vector<std::uint32_t> changed_ids;
     while (true) {
-      auto components = connected_components();
+      auto components = connected_components(components_of, changed_ids);
+
+      std::vector<char> is_regrouped(piles_.size(), 0);
+      for (const auto& it : components) {
+        for (const auto& jt : it) {
+          is_regrouped[jt] = 1;
+        }
+      }
+
       for (const auto& it : components) {
         std::vector<std::uint32_t> medians;
         for (const auto& jt : it) {
@@ -907,31 +1332,43 @@ void Graph::Construct(
         }
       }
 
-      for (const auto& it : overlaps.back()) {
-        piles_[it.lhs_id]->UpdateRepetitiveRegions(it);
-        piles_[it.rhs_id]->UpdateRepetitiveRegions(it);
-      }
+      // each pile is updated by the one task owning its read
+      valid_overlaps.ForEachRead(piles_.size(),
+          [&](std::uint32_t i, const biosoup::Overlap& it) -> void {
+            if (is_regrouped[i]) {
+              piles_[i]->UpdateRepetitiveRegions(it);
+            }
+          },
+          thread_pool_);
+
+      std::vector<std::atomic<bool>> is_changed_read(piles_.size());
+      valid_overlaps.Filter(
+          [&](biosoup::Overlap& it) -> bool {
+            if (piles_[it.lhs_id]->CheckRepetitiveRegions(it) ||
+                piles_[it.rhs_id]->CheckRepetitiveRegions(it)) {
+              is_changed_read[it.lhs_id] = true;
+              is_changed_read[it.rhs_id] = true;
+              return false;
+            }
+            return true;
+          },
+          thread_pool_);
 
-      bool is_changed = false;
-      std::uint32_t j = 0;
-      for (std::uint32_t i = 0; i < overlaps.back().size(); ++i) {
-        const auto& it = overlaps.back()[i];
-        if (piles_[it.lhs_id]->CheckRepetitiveRegions(it) ||
-            piles_[it.rhs_id]->CheckRepetitiveRegions(it)) {
-          is_changed = true;
-        } else {
-          overlaps.back()[j++] = it;
+      changed_ids.clear();
+      for (std::uint32_t i = 0; i < piles_.size(); ++i) {
+        if (is_changed_read[i]) {
+          changed_ids.emplace_back(i);
         }
       }
-      overlaps.back().resize(j);
 
-      if (!is_changed) {
+      if (changed_ids.empty()) {
         break;
       }
 
-      for (const auto& it : components) {
-        for (const auto& jt : it) {
-          piles_[jt]->ClearRepetitiveRegions();
+      auto is_member = component_members(components_of, changed_ids);
+      for (std::uint32_t i = 0; i < piles_.size(); ++i) {
+        if (is_member[i]) {
+          piles_[i]->ClearRepetitiveRegions();
         }
       }
     }
@@ -942,7 +1379,17 @@ void Graph::Construct(
     timer.Start();
   }
 
-  detail::StoreValidRegions(piles_, sequences);
+  if (stage_ == -4) {  // keep valid regions for GreedyConstruct
+    fillers_.clear();
+    for (const auto& it : piles_) {
+      if (it->length() >= constants::kMinSequenceLen) {
+        fillers_.push_back(Filler{it->id(), it->begin(), it->length()});
+      }
+    }
+
+    std::cerr << "[raven::Graph::Construct] kept " << fillers_.size()
+              << " sequence regions" << std::endl;
+  }
 
   assert(Node::num_objects == 0);  // TODO: Remove
   if (stage_ == -4) {              // construct assembly graph
@@ -952,30 +1399,35 @@ void Graph::Construct(
         continue;
       }
 
-      auto sequence = biosoup::Sequence{
-          sequences[it->id()]->name,
-          sequences[it->id()]->data.substr(it->begin(),
-                                           it->end() - it->begin())};  // NOLINT
+      PackedSequence data;
+      data.Append(sequences.bases(it->id()), it->begin(),
+                  it->end() - it->begin());
 
       sequence_to_node[it->id()] = Node::num_objects;
 
-      auto node = std::make_shared<Node>(sequence);
-      sequence.ReverseAndComplement();
+      auto node = std::make_shared<Node>(sequences.name(it->id()), data);
       nodes_.emplace_back(node);
-      nodes_.emplace_back(std::make_shared<Node>(sequence));
+      nodes_.emplace_back(std::make_shared<Node>(sequences.name(it->id()),
+                                                 data.ReverseComplement()));
       node->pair = nodes_.back().get();
       node->pair->pair = node.get();
     }
 
+    for (std::uint32_t i = 0; i < sequences.size(); ++i) {  // copied to nodes
+      sequences.Evict(i);
+    }
+
     std::cerr << "[raven::Graph::Construct] stored " << nodes_.size()
               << " nodes "  // NOLINT
               << std::fixed << timer.Stop() << "s" << std::endl;
 
     timer.Start();
 
-    for (auto& it : overlaps.back()) {  // create edges
+    // create edges
+    valid_overlaps.ForEach([&](const biosoup::Overlap& o) -> void {
+      auto it = o;
       if (!overlap_finalize(it)) {
-        continue;
+        return;
       }
 
       auto tail = nodes_[sequence_to_node[it.lhs_id]].get();
@@ -997,7 +1449,8 @@ void Graph::Construct(
                                                  length_pair));  // NOLINT
       edge->pair = edges_.back().get();
       edge->pair->pair = edge.get();
-    }
+    });
+    valid_overlaps.Clear();
 
     std::cerr << "[raven::Graph::Construct] stored " << edges_.size()
               << " edges "  // NOLINT
@@ -1019,14 +1472,31 @@ void Graph::Construct(
 }  // NOLINT
 
 std::size_t Graph::GreedyConstruct(
-    std::vector<std::unique_ptr<biosoup::Sequence>>& sequences) {
+    std::vector<std::unique_ptr<biosoup::Sequence>>& sequences,
+    PackedSequences& reads) {
   using detail::OverlapCategory;
   using detail::OverlapSide;
 
   sequences.resize(1);
 
   biosoup::Timer timer{};
-  auto fillers = util::LoadFillerSeqs();
+
+  std::vector<std::unique_ptr<biosoup::Sequence>> fillers;
+  {
+    std::vector<std::uint32_t> ids;
+    for (const auto& it : fillers_) {
+      ids.emplace_back(it.id);
+    }
+    reads.Fetch(ids);
+
+    for (const auto& it : fillers_) {
+      // default constructed, ids are normalized once merged with unitigs
+      fillers.emplace_back(new biosoup::Sequence());
+      fillers.back()->name = "nc" + std::to_string(it.id);
+      fillers.back()->data = reads.bases(it.id).substr(it.begin, it.length);
+      reads.Evict(it.id);
+    }
+  }
 
   auto const n_unitigs = sequences.size();
   auto n_fillers = fillers.size();
@@ -1212,32 +1682,27 @@ std::size_t Graph::GreedyConstruct(
 
   timer.Start();
 
-  std::size_t overlap_batch_size = 0;
-  overlaps.resize(sequences.size());
-  std::vector<std::future<std::vector<biosoup::Overlap>>> ovlp_futures;
-  for (std::size_t i = fillers_begin; i < fillers_end; ++i) {
-    overlap_batch_size += sequences[i]->data.size();
-    ovlp_futures.emplace_back(thread_pool_->Submit(
-        [&](std::size_t const pos) -> std::vector<biosoup::Overlap> {
-          return minimizer_engine_.Map(sequences[pos], true, false, true);
-        },
-        i));
-
-    if (i + 1 != fillers_end && overlap_batch_size < constants::kOvlpBatchLim) {
-      continue;
-    }
+  auto const sequence_length = [&](std::uint32_t i) -> std::size_t {
+    return sequences[i]->data.size();
+  };
 
-    for (auto& ovlp_vec : ovlp_futures) {
-      for (auto& ovlp : ovlp_vec.get()) {
-        auto const category = overlap_category(ovlp);
-        if (category != OverlapCategory::kIrrelevant) {
-          relevant_fillers.emplace(ovlp.lhs_id);
+  overlaps.resize(sequences.size());
+  detail::MapPipelined(thread_pool_, fillers_begin,
+      detail::BatchEnds(fillers_begin, fillers_end, sequence_length,
+                        planner_.MappingBases()),
+      [&](std::uint32_t i) -> std::vector<biosoup::Overlap> {
+        return minimizer_engine_.Map(sequences[i], true, false, true);
+      },
+      [&](std::vector<std::vector<biosoup::Overlap>>&& mapped) -> void {
+        for (auto& ovlp_vec : mapped) {
+          for (auto& ovlp : ovlp_vec) {
+            auto const category = overlap_category(ovlp);
+            if (category != OverlapCategory::kIrrelevant) {
+              relevant_fillers.emplace(ovlp.lhs_id);
+            }
+          }
         }
-      }
-    }
-
-    ovlp_futures.clear();
-  }
+      });
 
   sequences.erase(
       std::remove_if(sequences.begin() + fillers_begin,
@@ -1256,11 +1721,16 @@ std::size_t Graph::GreedyConstruct(
 
   overlaps.resize(sequences.size());
 
+  std::uint64_t resident_bytes = 0;  // bases and qualities
+  for (const auto& it : sequences) {
+    resident_bytes += it->data.size() + it->quality.size();
+  }
+  auto const index_bases = planner_.IndexBases(resident_bytes, false);
+
   std::size_t sequence_batch_size = 0;
   for (std::size_t i = 0, j = 0; i < sequences.size(); ++i) {
     sequence_batch_size += sequences[i]->data.size();
-    if (i + 1 != sequences.size() &&
-        sequence_batch_size < constants::kSeqsBatchLim) {
+    if (i + 1 != sequences.size() && sequence_batch_size < index_bases) {
       continue;
     }
 
@@ -1276,26 +1746,19 @@ std::size_t Graph::GreedyConstruct(
     timer.Start();
 
     if (i >= fillers_begin) {
-      std::size_t overlap_batch_size = 0;
-      std::vector<std::future<std::vector<biosoup::Overlap>>> ovlp_futures;
-      for (std::size_t k = j; k < i + 1; ++k) {
-        overlap_batch_size += sequences[k]->data.size();
-        ovlp_futures.emplace_back(thread_pool_->Submit(
-            [&](std::size_t pos) -> std::vector<biosoup::Overlap> {
-              return minimizer_engine_.Map(sequences[pos], true, true, true);
-            },
-            k));
-
-        if (k != i && overlap_batch_size < constants::kOvlpBatchLim) {
-          continue;
-        }
-
-        for (auto& ovlp_vec : ovlp_futures) {
-          for (auto& ovlp : ovlp_vec.get()) {
-            emplace_overlap(ovlp);
-          }
-        }
-      }
+      detail::MapPipelined(thread_pool_, j,
+          detail::BatchEnds(j, i + 1, sequence_length,
+                            planner_.MappingBases()),
+          [&](std::uint32_t k) -> std::vector<biosoup::Overlap> {
+            return minimizer_engine_.Map(sequences[k], true, true, true);
+          },
+          [&](std::vector<std::vector<biosoup::Overlap>>&& mapped) -> void {
+            for (auto& ovlp_vec : mapped) {
+              for (auto& ovlp : ovlp_vec) {
+                emplace_overlap(ovlp);
+              }
+            }
+          });
     }
 
     std::cerr << "[raven::Graph::GreedyConstruct] mapped sequences "
@@ -1729,7 +2192,7 @@ std::uint32_t Graph::RemoveBubbles() {
           }
         }
       }
-      sequence->data += path.back()->data;
+      sequence->data += path.back()->data.str();
       return std::move(sequence);
     };
 
@@ -2198,11 +2661,11 @@ void Graph::CreateForceDirectedLayout(const std::string& path) {
 }
 
 void Graph::Polish(
-    const std::vector<std::unique_ptr<biosoup::Sequence>>& sequences,
+    PackedSequences& reads,
     std::uint8_t match, std::uint8_t mismatch, std::uint8_t gap,
     std::uint32_t cuda_poa_batches, bool cuda_banded_alignment,
     std::uint32_t cuda_alignment_batches, std::uint32_t num_rounds) {
-  if (sequences.empty() || num_rounds == 0) {
+  if (reads.empty() || num_rounds == 0) {
     return;
   }
 
@@ -2211,16 +2674,15 @@ void Graph::Polish(
     return;
   }
 
-  double q = 0.;
-  for (const auto& it : sequences) {
-    if (it->quality.empty()) {
-      continue;
-    }
-    double p = 0.;
-    for (const auto& jt : it->quality) {
-      p += jt - 33;
-    }
-    q += p / it->quality.size();
+  reads.Fetch();
+  auto sequences = reads.Unpack(0, reads.size());  // racon needs bases
+  for (std::uint32_t i = 0; i < reads.size(); ++i) {
+    reads.Evict(i);
+  }
+
+  double q = 0.;  // means were taken while parsing
+  for (std::uint32_t i = 0; i < reads.size(); ++i) {
+    q += reads.mean_quality(i);
   }
   if (q == 0.) {  // when all values equal to '!'
     for (const auto& it : sequences) {
@@ -2245,9 +2707,8 @@ void Graph::Polish(
       if ((tag = it->name.rfind(':')) != std::string::npos) {
         if (std::atof(&it->name[tag + 1]) > 0) {
           node->is_polished = true;
-          node->data = it->data;
-          it->ReverseAndComplement();
-          node->pair->data = it->data;
+          node->data = PackedSequence(it->data);
+          node->pair->data = node->data.ReverseComplement();
         }
       }
     }
@@ -2419,7 +2880,7 @@ std::vector<std::unique_ptr<biosoup::Sequence>> Graph::GetUnitigs(
                        " RC:i:" + std::to_string(it->count) +
                        " XO:i:" + std::to_string(it->is_circular);
 
-    dst.emplace_back(new biosoup::Sequence(name, it->data));
+    dst.emplace_back(new biosoup::Sequence(name, it->data.str()));
   }
 
   return dst;
@@ -2543,40 +3004,49 @@ void Graph::PrintCSV(const std::string& path) const {
     return;
   }
 
-  std::ofstream os(path);
+  std::vector<const Node*> nodes;
+  std::vector<const Node*> circular_nodes;
   for (const auto& it : nodes_) {
-    if ((it == nullptr) || it->is_rc() ||
-        (it->count == 1 && it->outdegree() == 0 && it->indegree() == 0)) {
-      continue;
-    }
-    os << it->id << " [" << it->id / 2 << "]"
-       << " LN:i:" << it->data.size() << " RC:i:" << it->count << ","
-       << it->pair->id << " [" << it->pair->id / 2 << "]"
-       << " LN:i:" << it->pair->data.size() << " RC:i:" << it->pair->count
-       << ",0,-" << std::endl;
-  }
-  for (const auto& it : edges_) {
     if (it == nullptr) {
       continue;
     }
-    os << it->tail->id << " [" << it->tail->id / 2 << "]"
-       << " LN:i:" << it->tail->data.size() << " RC:i:" << it->tail->count
-       << "," << it->head->id << " [" << it->head->id / 2 << "]"
-       << " LN:i:" << it->head->data.size() << " RC:i:" << it->head->count
-       << ",1," << it->id << " " << it->length << " " << it->weight
-       << std::endl;
+    if (!it->is_rc() &&
+        !(it->count == 1 && it->outdegree() == 0 && it->indegree() == 0)) {
+      nodes.emplace_back(it.get());
+    }
+    if (it->is_circular) {  // TODO(rvaser): check
+      circular_nodes.emplace_back(it.get());
+    }
   }
-  for (const auto& it : nodes_) {  // circular edges TODO(rvaser): check
-    if (it == nullptr || !it->is_circular) {
-      continue;
+  std::vector<const Edge*> edges;
+  for (const auto& it : edges_) {
+    if (it) {
+      edges.emplace_back(it.get());
     }
-    os << it->id << " [" << it->id / 2 << "]"
-       << " LN:i:" << it->data.size() << " RC:i:" << it->count << "," << it->id
-       << " [" << it->id / 2 << "]"
-       << " LN:i:" << it->data.size() << " RC:i:" << it->count << ",1,-"
-       << std::endl;
   }
-  os.close();
+
+  auto label = [] (const Node* node) -> std::string {
+    return std::to_string(node->id) + " [" + std::to_string(node->id / 2) +
+           "] LN:i:" + std::to_string(node->data.size()) +
+           " RC:i:" + std::to_string(node->count);
+  };
+
+  util::Writer writer(path, thread_pool_);
+  writer.Write(nodes.size(), [&] (std::size_t i, std::string& dst) -> void {
+    dst += label(nodes[i]) + "," + label(nodes[i]->pair) + ",0,-\n";
+  });
+  writer.Write(edges.size(), [&] (std::size_t i, std::string& dst) -> void {
+    char weight[32];
+    std::snprintf(weight, sizeof(weight), "%g", edges[i]->weight);
+    dst += label(edges[i]->tail) + "," + label(edges[i]->head) + ",1," +
+           std::to_string(edges[i]->id) + " " +
+           std::to_string(edges[i]->length) + " " + weight + "\n";
+  });
+  writer.Write(circular_nodes.size(),
+      [&] (std::size_t i, std::string& dst) -> void {
+        dst += label(circular_nodes[i]) + "," + label(circular_nodes[i]) +
+               ",1,-\n";
+      });
 }
 
 void Graph::PrintGFA(const std::string& path) const {
@@ -2584,28 +3054,37 @@ void Graph::PrintGFA(const std::string& path) const {
     return;
   }
 
-  std::ofstream os(path);
+  std::vector<const Node*> nodes;
   for (const auto& it : nodes_) {
     if ((it == nullptr) || it->is_rc() ||
         (it->count == 1 && it->outdegree() == 0 && it->indegree() == 0)) {
       continue;
     }
-    os << "S\t" << it->name << "\t" << it->data << "\tLN:i:" << it->data.size()
-       << "\tRC:i:" << it->count << std::endl;
-    if (it->is_circular) {
-      os << "L\t" << it->name << "\t" << '+' << "\t" << it->name << "\t" << '+'
-         << "\t0M" << std::endl;
-    }
+    nodes.emplace_back(it.get());
   }
+  std::vector<const Edge*> edges;
   for (const auto& it : edges_) {
-    if (it == nullptr) {
-      continue;
+    if (it) {
+      edges.emplace_back(it.get());
     }
-    os << "L\t" << it->tail->name << "\t" << (it->tail->is_rc() ? '-' : '+')
-       << "\t" << it->head->name << "\t" << (it->head->is_rc() ? '-' : '+')
-       << "\t" << it->tail->data.size() - it->length << 'M' << std::endl;
   }
-  os.close();
+
+  util::Writer writer(path, thread_pool_);
+  writer.Write(nodes.size(), [&] (std::size_t i, std::string& dst) -> void {
+    const auto& it = nodes[i];
+    dst += "S\t" + it->name + "\t" + it->data.str() +
+           "\tLN:i:" + std::to_string(it->data.size()) +
+           "\tRC:i:" + std::to_string(it->count) + "\n";
+    if (it->is_circular) {
+      dst += "L\t" + it->name + "\t+\t" + it->name + "\t+\t0M\n";
+    }
+  });
+  writer.Write(edges.size(), [&] (std::size_t i, std::string& dst) -> void {
+    const auto& it = edges[i];
+    dst += "L\t" + it->tail->name + "\t" + (it->tail->is_rc() ? '-' : '+') +
+           "\t" + it->head->name + "\t" + (it->head->is_rc() ? '-' : '+') +
+           "\t" + std::to_string(it->tail->data.size() - it->length) + "M\n";
+  });
 }
 
 void Graph::Store() const {
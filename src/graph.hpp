@@ -21,6 +21,13 @@
 #include "ram/minimizer_engine.hpp"
 #include "thread_pool/thread_pool.hpp"
 
+#include "batch_planner.hpp"
+#include "common.hpp"
+#include "overlap_cache.hpp"
+#include "overlap_reservoir.hpp"
+#include "overlap_spill.hpp"
+#include "overlap_store.hpp"
+#include "packed_sequence.hpp"
 #include "pile.hpp"
 
 namespace raven {
@@ -41,19 +48,53 @@ class Graph {
 
   int stage() const { return stage_; }
 
+  // overlaps between valid reads beyond max_bytes are spilled to files in dir
+  // during Construct, 0 keeps all of them in memory
+  void set_spill(const std::string& dir, std::uint64_t max_bytes) {
+    spill_dir_ = dir;
+    spill_limit_ = max_bytes;
+  }
+
+  // batches of reads are sized to fit into max_bytes of memory, 0 keeps the
+  // fixed batch limits
+  void set_memory_limit(std::uint64_t max_bytes) {
+    planner_ = BatchPlanner(max_bytes, window_len_);
+  }
+
+  const BatchPlanner& planner() const {
+    return planner_;
+  }
+
+  // Construct takes overlaps from a PAF file instead of mapping reads
+  void set_overlaps_path(const std::string& path) {
+    overlaps_path_ = path;
+  }
+
+  // Construct replays overlaps cached in path for the same inputs instead of
+  // mapping reads, or caches them there when it has to map
+  void set_overlap_cache(const std::string& path,
+                         std::vector<util::InputFingerprint> inputs) {
+    overlap_cache_path_ = path;
+    inputs_ = std::move(inputs);
+  }
+
   // takes ownership of the passed collection
   std::vector<std::unique_ptr<biosoup::Sequence>> Preprocess(
       std::vector<std::unique_ptr<biosoup::Sequence>>&& sequences);
 
   // break chimeric sequences, remove contained sequences and overlaps not
-  // spanning bridged repeats at sequence ends
+  // spanning bridged repeats at sequence ends; with a stream, sequences are
+  // appended batch by batch while the previous batches are being mapped
   void Construct(
-      std::vector<std::unique_ptr<biosoup::Sequence>>& sequences);  // NOLINT
+      PackedSequences& sequences,  // NOLINT
+      util::SequenceStream* stream = nullptr);
 
-  // tries to reassemble unitig endings with relevant reads
+  // tries to reassemble unitig endings with relevant reads, fillers are the
+  // valid regions of reads found by the last Construct
   // reutrns the expected number reconstructable organisms
   std::size_t GreedyConstruct(
-      std::vector<std::unique_ptr<biosoup::Sequence>>& unitigs);
+      std::vector<std::unique_ptr<biosoup::Sequence>>& unitigs,
+      PackedSequences& reads);
 
   // simplify with transitive reduction, tip prunning and bubble popping
   void Assemble();
@@ -61,9 +102,9 @@ class Graph {
   // with the longest chain of unitig - filler overlaps
   void GreedyAssemble(std::size_t const expected);
 
-  // Racon wrapper
+  // Racon wrapper, evicted sequences are fetched for the duration of the call
   void Polish(  // TODO: Conf overload
-      const std::vector<std::unique_ptr<biosoup::Sequence>>& sequences,
+      PackedSequences& sequences,
       std::uint8_t match, std::uint8_t mismatch, std::uint8_t gap,
       std::uint32_t cuda_poa_batches, bool cuda_banded_alignment,
       std::uint32_t cuda_alignment_batches, std::uint32_t num_rounds);
@@ -118,14 +159,14 @@ class Graph {
       }
     }
 
-    archive(stage_, piles_, nodes_, edges_, connections);
+    archive(stage_, piles_, nodes_, edges_, connections, fillers_);
   }
 
   template <class Archive>
   void load(Archive& archive) {  // NOLINT
     std::vector<std::pair<std::uint32_t, std::uint32_t>> connections;
 
-    archive(stage_, piles_, nodes_, edges_, connections);
+    archive(stage_, piles_, nodes_, edges_, connections, fillers_);
 
     for (std::uint32_t i = 0; i < nodes_.size(); i += 2) {
       if (nodes_[i]) {
@@ -162,6 +203,7 @@ class Graph {
     Node() = default;  // needed for cereal
 
     explicit Node(const biosoup::Sequence& sequence);
+    Node(const std::string& name, PackedSequence data);
     Node(Node* begin, Node* end);
 
     Node(const Node&) = delete;
@@ -191,7 +233,7 @@ class Graph {
 
     std::uint32_t id;
     std::string name;
-    std::string data;
+    PackedSequence data;
     std::uint32_t count;
     bool is_circular;
     bool is_polished;
@@ -241,10 +283,33 @@ class Graph {
   void CreateForceDirectedLayout(const std::string& path = "");
 
   std::shared_ptr<thread_pool::ThreadPool> thread_pool_;
+  std::uint32_t kmer_len_;
+  std::uint32_t window_len_;
   ram::MinimizerEngine minimizer_engine_;
+  BatchPlanner planner_;
+
+  std::string spill_dir_ = ".";
+  std::uint64_t spill_limit_ = 0;
+  std::string overlaps_path_ = "";
+  std::string overlap_cache_path_ = "";
+  std::vector<util::InputFingerprint> inputs_;
 
   int stage_;
   std::vector<std::unique_ptr<Pile>> piles_;
+
+  // valid region of a read, kept over Clear for GreedyConstruct
+  struct Filler {
+    template <class Archive>
+    void serialize(Archive& archive) {  // NOLINT
+      archive(id, begin, length);
+    }
+
+    std::uint32_t id;
+    std::uint32_t begin;
+    std::uint32_t length;
+  };
+  std::vector<Filler> fillers_;
+
   std::vector<std::shared_ptr<Node>> nodes_;
   std::vector<std::shared_ptr<Edge>> edges_;
 };
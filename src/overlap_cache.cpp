@@ -0,0 +1,238 @@
+#include "overlap_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace raven {
+
+namespace detail {
+
+char constexpr kCacheMagic[8] = {'R', 'A', 'V', 'E', 'N', 'O', 'V', 'L'};
+
+// bumped whenever the layout or the way overlaps are found changes
+std::uint64_t constexpr kCacheVersion = 3;
+
+// FNV-1a
+class Hasher {
+ public:
+  void Add(const void* data, std::size_t size) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      value_ = (value_ ^ bytes[i]) * 1099511628211ULL;
+    }
+  }
+
+  template <class T>
+  void Add(const T& value) {
+    Add(&value, sizeof(value));
+  }
+
+  std::uint64_t value() const {
+    return value_;
+  }
+
+ private:
+  std::uint64_t value_ = 14695981039346656037ULL;
+};
+
+}  // namespace detail
+
+std::uint64_t OverlapCache::Key(
+    const std::vector<util::InputFingerprint>& inputs,
+    std::uint32_t k, std::uint32_t w) {
+  detail::Hasher hasher;
+  hasher.Add(detail::kCacheVersion);
+  for (const auto& it : inputs) {
+    hasher.Add(it.path.data(), it.path.size() + 1);
+    hasher.Add(it.size);
+    hasher.Add(it.mtime);
+  }
+  hasher.Add(k);
+  hasher.Add(w);
+  hasher.Add(constants::kKMerDiscardFreqHard);
+  hasher.Add(constants::kMerDiscardFreqSoft);
+  hasher.Add(constants::kMinSequenceLen);
+  return hasher.value();
+}
+
+std::uint64_t OverlapCache::ReadsKey(const PackedSequences& sequences) {
+  detail::Hasher hasher;
+  hasher.Add(sequences.size());
+  for (std::uint32_t i = 0; i < sequences.size(); ++i) {
+    hasher.Add(sequences.length(i));
+  }
+  return hasher.value();
+}
+
+std::unique_ptr<OverlapCache> OverlapCache::Open(const std::string& path,
+                                                 std::uint64_t key) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<std::uint64_t>(st.st_size) < sizeof(Header)) {
+    close(fd);
+    return nullptr;
+  }
+  std::uint64_t size = st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping stays valid
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  std::unique_ptr<OverlapCache> dst(
+      new OverlapCache(static_cast<const char*>(data), size));
+
+  const auto& header = *dst->header_;
+  std::uint64_t num_batches = 0;
+  for (std::uint32_t i = 0; i < kNumSections; ++i) {
+    num_batches += header.num_batches[i];
+  }
+  if (std::memcmp(header.magic, detail::kCacheMagic, 8) != 0 ||
+      header.version != detail::kCacheVersion || header.key != key ||
+      size != sizeof(Header) + header.num_records * sizeof(Record) +
+              num_batches * (sizeof(std::uint64_t) + sizeof(std::uint32_t))) {
+    return nullptr;
+  }
+
+  auto batch_sections = reinterpret_cast<const std::uint32_t*>(
+      dst->batch_ends_ + num_batches);
+  for (std::uint64_t i = 0; i < num_batches; ++i) {
+    if (batch_sections[i] >= kNumSections) {
+      return nullptr;
+    }
+    dst->batches_[batch_sections[i]].emplace_back(i);
+  }
+  for (std::uint32_t i = 0; i < kNumSections; ++i) {
+    if (dst->batches_[i].size() != header.num_batches[i]) {
+      return nullptr;
+    }
+  }
+  return dst;
+}
+
+OverlapCache::OverlapCache(const char* data, std::uint64_t size)
+    : data_(data),
+      size_(size),
+      header_(reinterpret_cast<const Header*>(data)),
+      records_(reinterpret_cast<const Record*>(data + sizeof(Header))),
+      batch_ends_(reinterpret_cast<const std::uint64_t*>(
+          data + sizeof(Header) + header_->num_records * sizeof(Record))),
+      batches_() {}
+
+OverlapCache::~OverlapCache() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+std::uint64_t OverlapCache::reads_key() const {
+  return header_->reads_key;
+}
+
+std::uint64_t OverlapCache::num_batches(Section section) const {
+  return header_->num_batches[section];
+}
+
+std::vector<biosoup::Overlap> OverlapCache::Batch(
+    Section section, std::uint64_t i) const {
+  i = batches_[section][i];
+  auto begin = i == 0 ? 0 : batch_ends_[i - 1];
+  auto end = batch_ends_[i];
+
+  std::vector<biosoup::Overlap> dst;
+  dst.reserve(end - begin);
+  for (auto it = records_ + begin; it != records_ + end; ++it) {
+    dst.emplace_back(it->lhs_id, it->lhs_begin, it->lhs_end, it->rhs_id,
+                     it->rhs_begin, it->rhs_end, it->score, it->strand);
+  }
+  return dst;
+}
+
+OverlapCacheWriter::OverlapCacheWriter(std::string path, std::uint64_t key)
+    : path_(std::move(path)),
+      os_(path_ + ".tmp", std::ios::binary | std::ios::trunc),
+      header_(),
+      batch_ends_(),
+      batch_sections_() {
+  if (!os_.is_open()) {
+    throw std::runtime_error(
+        "[raven::OverlapCacheWriter::OverlapCacheWriter] error: unable to "
+        "create " + path_ + ".tmp");
+  }
+  std::memcpy(header_.magic, detail::kCacheMagic, 8);
+  header_.version = detail::kCacheVersion;
+  header_.key = key;
+  os_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+}
+
+OverlapCacheWriter::~OverlapCacheWriter() {
+  if (os_.is_open()) {
+    os_.close();
+    std::remove((path_ + ".tmp").c_str());
+  }
+}
+
+void OverlapCacheWriter::Write(OverlapCache::Section section,
+                               const std::vector<biosoup::Overlap>& batch) {
+  Append(batch);
+  EndBatch(section);
+}
+
+void OverlapCacheWriter::Write(
+    OverlapCache::Section section,
+    const std::vector<std::vector<biosoup::Overlap>>& batch) {
+  for (const auto& it : batch) {
+    Append(it);
+  }
+  EndBatch(section);
+}
+
+void OverlapCacheWriter::Append(
+    const std::vector<biosoup::Overlap>& overlaps) {
+  std::vector<OverlapCache::Record> records;
+  records.reserve(overlaps.size());
+  for (const auto& it : overlaps) {
+    records.push_back(OverlapCache::Record{
+        it.lhs_id, it.lhs_begin, it.lhs_end, it.rhs_id, it.rhs_begin,
+        it.rhs_end, it.score, it.strand});
+  }
+  os_.write(reinterpret_cast<const char*>(records.data()),
+            records.size() * sizeof(OverlapCache::Record));
+  header_.num_records += records.size();
+}
+
+void OverlapCacheWriter::EndBatch(OverlapCache::Section section) {
+  ++header_.num_batches[section];
+  batch_ends_.emplace_back(header_.num_records);
+  batch_sections_.emplace_back(section);
+}
+
+void OverlapCacheWriter::Close(std::uint64_t reads_key) {
+  header_.reads_key = reads_key;
+  os_.write(reinterpret_cast<const char*>(batch_ends_.data()),
+            batch_ends_.size() * sizeof(std::uint64_t));
+  os_.write(reinterpret_cast<const char*>(batch_sections_.data()),
+            batch_sections_.size() * sizeof(std::uint32_t));
+  os_.seekp(0);
+  os_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+  os_.close();
+
+  if (os_.fail() ||
+      std::rename((path_ + ".tmp").c_str(), path_.c_str()) != 0) {
+    std::remove((path_ + ".tmp").c_str());
+    throw std::runtime_error(
+        "[raven::OverlapCacheWriter::Close] error: unable to write " + path_);
+  }
+}
+
+}  // namespace raven
@@ -0,0 +1,124 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_OVERLAP_CACHE_HPP_
+#define RAVEN_OVERLAP_CACHE_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "biosoup/overlap.hpp"
+
+#include "common.hpp"
+#include "packed_sequence.hpp"
+
+namespace raven {
+
+// overlaps found by Construct, stored in the order they were mapped as
+// batches, each in one of three sections (one per mapping pass) which can
+// interleave; the file is memory mapped when read back so a hit costs page-ins
+// only
+class OverlapCache {
+ public:
+  enum Section : std::uint32_t {
+    kPiles = 0,    // all reads to each other, stage -5
+    kInvalid = 1,  // invalid reads to valid ones, stage -4
+    kValid = 2,    // valid reads to each other, classified, stage -4
+    kNumSections = 3
+  };
+
+  // identifies overlaps of inputs found with minimizers of k and w
+  static std::uint64_t Key(const std::vector<util::InputFingerprint>& inputs,
+                           std::uint32_t k, std::uint32_t w);
+
+  // identifies reads by their number and lengths
+  static std::uint64_t ReadsKey(const PackedSequences& sequences);
+
+  // nullptr if path does not hold a complete cache of key
+  static std::unique_ptr<OverlapCache> Open(const std::string& path,
+                                            std::uint64_t key);
+
+  OverlapCache(const OverlapCache&) = delete;
+  OverlapCache& operator=(const OverlapCache&) = delete;
+
+  ~OverlapCache();
+
+  // ReadsKey of the reads the overlaps were found for
+  std::uint64_t reads_key() const;
+
+  std::uint64_t num_batches(Section section) const;
+
+  std::vector<biosoup::Overlap> Batch(Section section, std::uint64_t i) const;
+
+ private:
+  friend class OverlapCacheWriter;
+
+  struct Header {
+    char magic[8];
+    std::uint64_t version;
+    std::uint64_t key;
+    std::uint64_t reads_key;
+    std::uint64_t num_records;
+    std::uint64_t num_batches[kNumSections];
+  };
+
+  struct Record {
+    std::uint32_t lhs_id;
+    std::uint32_t lhs_begin;
+    std::uint32_t lhs_end;
+    std::uint32_t rhs_id;
+    std::uint32_t rhs_begin;
+    std::uint32_t rhs_end;
+    std::uint32_t score;
+    std::uint32_t strand;
+  };
+
+  OverlapCache(const char* data, std::uint64_t size);
+
+  const char* data_;
+  std::uint64_t size_;
+  const Header* header_;
+  const Record* records_;
+  // ends of batches in records_
+  const std::uint64_t* batch_ends_;
+  // batches of each section in order
+  std::vector<std::uint64_t> batches_[kNumSections];
+};
+
+// writes a cache to a temporary file next to path, which replaces path once
+// all sections are in; left unfinished the temporary file is removed
+class OverlapCacheWriter {
+ public:
+  OverlapCacheWriter(std::string path, std::uint64_t key);
+
+  OverlapCacheWriter(const OverlapCacheWriter&) = delete;
+  OverlapCacheWriter& operator=(const OverlapCacheWriter&) = delete;
+
+  ~OverlapCacheWriter();
+
+  // appends a batch to section
+  void Write(OverlapCache::Section section,
+             const std::vector<biosoup::Overlap>& batch);
+
+  void Write(OverlapCache::Section section,
+             const std::vector<std::vector<biosoup::Overlap>>& batch);
+
+  void Close(std::uint64_t reads_key);
+
+ private:
+  void Append(const std::vector<biosoup::Overlap>& overlaps);
+
+  void EndBatch(OverlapCache::Section section);
+
+  std::string path_;
+  std::ofstream os_;
+  OverlapCache::Header header_;
+  std::vector<std::uint64_t> batch_ends_;
+  std::vector<std::uint32_t> batch_sections_;
+};
+
+}  // namespace raven
+
+#endif  // RAVEN_OVERLAP_CACHE_HPP_
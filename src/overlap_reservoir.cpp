@@ -0,0 +1,79 @@
+#include "overlap_reservoir.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace raven {
+
+namespace detail {
+
+std::uint32_t constexpr kReservoirStrandFlag = 1U << 31;
+
+}  // namespace detail
+
+OverlapReservoir::OverlapReservoir(std::uint32_t capacity)
+    : capacity_(capacity),
+      sizes_(),
+      slots_() {
+  if (capacity_ == 0 || capacity_ > 255) {
+    throw std::invalid_argument(
+        "[raven::OverlapReservoir::OverlapReservoir] error: "
+        "capacity out of range");
+  }
+}
+
+std::uint32_t OverlapReservoir::Length(const Slot& slot) {
+  return std::max(slot.lhs_end - slot.lhs_begin, slot.rhs_end - slot.rhs_begin);
+}
+
+void OverlapReservoir::Resize(std::uint32_t num_reads) {
+  if (num_reads > sizes_.size()) {
+    sizes_.resize(num_reads, 0);
+    slots_.resize(static_cast<std::uint64_t>(num_reads) * capacity_);
+  }
+}
+
+void OverlapReservoir::Push(std::uint32_t id, const biosoup::Overlap& o) {
+  Slot slot{o.rhs_id | (o.strand ? detail::kReservoirStrandFlag : 0),
+            o.lhs_begin, o.lhs_end, o.rhs_begin, o.rhs_end};
+
+  // shortest kept overlap on top
+  auto is_longer = [] (const Slot& lhs, const Slot& rhs) -> bool {
+    return Length(lhs) > Length(rhs);
+  };
+  auto first = slots_.begin() + static_cast<std::uint64_t>(id) * capacity_;
+  auto& size = sizes_[id];
+  if (size < capacity_) {
+    first[size++] = slot;
+    std::push_heap(first, first + size, is_longer);
+  } else if (Length(slot) > Length(first[0])) {
+    std::pop_heap(first, first + size, is_longer);
+    first[size - 1] = slot;
+    std::push_heap(first, first + size, is_longer);
+  }
+}
+
+std::vector<biosoup::Overlap> OverlapReservoir::Unpack(std::uint32_t id) const {
+  auto first = slots_.begin() + static_cast<std::uint64_t>(id) * capacity_;
+  std::vector<Slot> slots(first, first + sizes_[id]);
+  std::sort(slots.begin(), slots.end(),
+      [] (const Slot& lhs, const Slot& rhs) -> bool {
+        return Length(lhs) > Length(rhs);
+      });
+
+  std::vector<biosoup::Overlap> dst;
+  dst.reserve(slots.size());
+  for (const auto& it : slots) {
+    dst.emplace_back(id, it.lhs_begin, it.lhs_end,
+                     it.id & ~detail::kReservoirStrandFlag, it.rhs_begin,
+                     it.rhs_end, 0, it.id & detail::kReservoirStrandFlag);
+  }
+  return dst;
+}
+
+void OverlapReservoir::Clear() {
+  std::vector<std::uint8_t>().swap(sizes_);
+  std::vector<Slot>().swap(slots_);
+}
+
+}  // namespace raven
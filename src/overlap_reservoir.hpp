@@ -0,0 +1,57 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_OVERLAP_RESERVOIR_HPP_
+#define RAVEN_OVERLAP_RESERVOIR_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "biosoup/overlap.hpp"
+
+namespace raven {
+
+// keeps the capacity longest overlaps of each read in a fixed-size min-heap
+// on overlap length, so memory does not grow with coverage; overlaps are kept
+// from the side of their read (as lhs) and scores are not kept
+class OverlapReservoir {
+ public:
+  explicit OverlapReservoir(std::uint32_t capacity);
+
+  std::uint32_t num_reads() const {
+    return sizes_.size();
+  }
+
+  std::uint32_t size(std::uint32_t id) const {
+    return sizes_[id];
+  }
+
+  // only raises the number of reads
+  void Resize(std::uint32_t num_reads);
+
+  // o has read id as lhs, pushes to different reads can run concurrently
+  void Push(std::uint32_t id, const biosoup::Overlap& o);
+
+  // kept overlaps of read id, longest first
+  std::vector<biosoup::Overlap> Unpack(std::uint32_t id) const;
+
+  void Clear();
+
+ private:
+  struct Slot {
+    std::uint32_t id;  // the other read, with strand in the top bit
+    std::uint32_t lhs_begin;
+    std::uint32_t lhs_end;
+    std::uint32_t rhs_begin;
+    std::uint32_t rhs_end;
+  };
+
+  static std::uint32_t Length(const Slot& slot);
+
+  std::uint32_t capacity_;
+  std::vector<std::uint8_t> sizes_;
+  std::vector<Slot> slots_;  // capacity_ per read
+};
+
+}  // namespace raven
+
+#endif  // RAVEN_OVERLAP_RESERVOIR_HPP_
@@ -0,0 +1,276 @@
+#include "overlap_spill.hpp"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "common.hpp"
+
+namespace raven {
+
+namespace detail {
+
+// number of spilled overlaps read or written at once
+std::uint64_t constexpr kSpillChunk = 1ULL << 16;
+
+// number of overlaps handed to the thread pool at once
+std::uint64_t constexpr kParallelChunk = 1ULL << 20;
+
+std::uint32_t NumTasks(std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  return thread_pool ? thread_pool->num_threads() : 1;
+}
+
+// keeps overlaps of [first, last) for which keep returns true at the front,
+// slices are filtered concurrently and moved together afterwards; returns the
+// number of kept overlaps
+std::uint64_t FilterRun(
+    biosoup::Overlap* first, biosoup::Overlap* last,
+    const std::function<bool(biosoup::Overlap&)>& keep,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  std::uint32_t num_tasks = NumTasks(thread_pool);
+  std::uint64_t slice_len = (last - first + num_tasks - 1) / num_tasks;
+  std::vector<std::uint64_t> sizes(num_tasks, 0);
+  util::ParallelFor(thread_pool, num_tasks,
+      [&] (std::uint32_t begin, std::uint32_t end) -> void {
+        for (auto i = begin; i < end; ++i) {
+          auto slice = first + std::min<std::uint64_t>(
+              last - first, i * slice_len);
+          auto slice_end = first + std::min<std::uint64_t>(
+              last - first, (i + 1) * slice_len);
+          auto k = slice;
+          for (auto it = slice; it != slice_end; ++it) {
+            if (keep(*it)) {
+              *(k++) = *it;
+            }
+          }
+          sizes[i] = k - slice;
+        }
+      });
+
+  std::uint64_t k = 0;
+  for (std::uint32_t i = 0; i < num_tasks; ++i) {
+    auto slice = first + std::min<std::uint64_t>(last - first, i * slice_len);
+    std::move(slice, slice + sizes[i], first + k);
+    k += sizes[i];
+  }
+  return k;
+}
+
+}  // namespace detail
+
+OverlapSpill::OverlapSpill(std::string dir, std::uint64_t max_bytes)
+    : dir_(std::move(dir)),
+      max_bytes_(max_bytes),
+      fd_(-1),
+      num_spilled_(0),
+      buffer_() {}
+
+OverlapSpill::~OverlapSpill() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+OverlapSpill::Record OverlapSpill::Pack(const biosoup::Overlap& o) {
+  return Record{o.lhs_id, o.lhs_begin, o.lhs_end, o.rhs_id, o.rhs_begin,
+                o.rhs_end, o.score, o.strand};
+}
+
+biosoup::Overlap OverlapSpill::Unpack(const Record& r) {
+  return biosoup::Overlap(r.lhs_id, r.lhs_begin, r.lhs_end, r.rhs_id,
+                          r.rhs_begin, r.rhs_end, r.score, r.strand);
+}
+
+void OverlapSpill::emplace_back(const biosoup::Overlap& o) {
+  buffer_.emplace_back(o);
+  if (max_bytes_ > 0 && buffer_.size() > 1 &&
+      buffer_.size() * sizeof(biosoup::Overlap) >= max_bytes_) {
+    Spill();
+  }
+}
+
+void OverlapSpill::ForEach(
+    const std::function<void(const biosoup::Overlap&)>& f) const {
+  std::vector<Record> records;
+  for (std::uint64_t i = 0; i < num_spilled_; i += detail::kSpillChunk) {
+    records.resize(std::min(detail::kSpillChunk, num_spilled_ - i));
+    Read(i, records);
+    for (const auto& it : records) {
+      f(Unpack(it));
+    }
+  }
+  for (const auto& it : buffer_) {
+    f(it);
+  }
+}
+
+void OverlapSpill::ForEachRead(
+    std::uint32_t num_reads,
+    const std::function<void(std::uint32_t, const biosoup::Overlap&)>& f,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) const {
+  std::uint32_t num_tasks = detail::NumTasks(thread_pool);
+  std::uint32_t range_len =
+      std::max(1U, (num_reads + num_tasks - 1) / num_tasks);
+
+  ForEachRun([&] (const biosoup::Overlap* first,
+                  const biosoup::Overlap* last) -> void {
+    // sides of overlaps (index << 1 | is_rhs) of each slice of the run,
+    // grouped by the task owning their reads
+    std::uint64_t slice_len = (last - first + num_tasks - 1) / num_tasks;
+    std::vector<std::vector<std::vector<std::uint32_t>>> sides(
+        num_tasks, std::vector<std::vector<std::uint32_t>>(num_tasks));
+    util::ParallelFor(thread_pool, num_tasks,
+        [&] (std::uint32_t begin, std::uint32_t end) -> void {
+          for (auto i = begin; i < end; ++i) {
+            auto slice_end = std::min<std::uint64_t>(
+                last - first, (i + 1) * slice_len);
+            for (auto j = i * slice_len; j < slice_end; ++j) {
+              sides[i][first[j].lhs_id / range_len].emplace_back(j << 1);
+              sides[i][first[j].rhs_id / range_len].emplace_back(j << 1 | 1);
+            }
+          }
+        });
+    util::ParallelFor(thread_pool, num_tasks,
+        [&] (std::uint32_t begin, std::uint32_t end) -> void {
+          for (auto i = begin; i < end; ++i) {
+            for (const auto& it : sides) {
+              for (const auto& jt : it[i]) {
+                const auto& o = first[jt >> 1];
+                f(jt & 1 ? o.rhs_id : o.lhs_id, o);
+              }
+            }
+          }
+        });
+  });
+}
+
+void OverlapSpill::Filter(
+    const std::function<bool(biosoup::Overlap&)>& keep,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  std::vector<Record> records;
+  std::vector<biosoup::Overlap> overlaps;
+  std::uint64_t k = 0;  // never ahead of reading
+  for (std::uint64_t i = 0; i < num_spilled_; i += detail::kParallelChunk) {
+    records.resize(std::min(detail::kParallelChunk, num_spilled_ - i));
+    Read(i, records);
+
+    overlaps.clear();
+    for (const auto& it : records) {
+      overlaps.emplace_back(Unpack(it));
+    }
+    overlaps.resize(detail::FilterRun(
+        overlaps.data(), overlaps.data() + overlaps.size(), keep,
+        thread_pool));
+
+    records.clear();
+    for (const auto& it : overlaps) {
+      records.emplace_back(Pack(it));
+    }
+    Write(k, records);
+    k += records.size();
+  }
+  num_spilled_ = k;
+
+  buffer_.resize(detail::FilterRun(
+      buffer_.data(), buffer_.data() + buffer_.size(), keep, thread_pool));
+
+  if (buffer_.empty() && num_spilled_ > 0) {  // back() stays in memory
+    records.resize(1);
+    Read(--num_spilled_, records);
+    buffer_.emplace_back(Unpack(records.front()));
+  }
+  if (fd_ != -1 && ftruncate(fd_, num_spilled_ * sizeof(Record)) != 0) {
+    throw std::runtime_error(
+        "[raven::OverlapSpill::Filter] error: unable to truncate spill file");
+  }
+}
+
+void OverlapSpill::Clear() {
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+  num_spilled_ = 0;
+  std::vector<biosoup::Overlap>().swap(buffer_);
+}
+
+void OverlapSpill::Spill() {
+  if (fd_ == -1) {
+    auto path = dir_ + "/raven.overlaps.XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.emplace_back('\0');
+
+    fd_ = mkstemp(name.data());
+    if (fd_ == -1) {
+      throw std::runtime_error(
+          "[raven::OverlapSpill::Spill] error: unable to create file in " +
+          dir_);
+    }
+    unlink(name.data());  // removed once closed
+  }
+
+  std::vector<Record> records;
+  auto n = buffer_.size() - 1;
+  for (std::uint64_t i = 0; i < n; i += detail::kSpillChunk) {
+    records.clear();
+    for (auto j = i; j < std::min(n, i + detail::kSpillChunk); ++j) {
+      records.emplace_back(Pack(buffer_[j]));
+    }
+    Write(num_spilled_, records);
+    num_spilled_ += records.size();
+  }
+  buffer_.erase(buffer_.begin(), buffer_.begin() + n);
+}
+
+void OverlapSpill::ForEachRun(
+    const std::function<void(const biosoup::Overlap*,
+                             const biosoup::Overlap*)>& f) const {
+  std::vector<Record> records;
+  std::vector<biosoup::Overlap> overlaps;
+  for (std::uint64_t i = 0; i < num_spilled_; i += detail::kParallelChunk) {
+    records.resize(std::min(detail::kParallelChunk, num_spilled_ - i));
+    Read(i, records);
+
+    overlaps.clear();
+    for (const auto& it : records) {
+      overlaps.emplace_back(Unpack(it));
+    }
+    f(overlaps.data(), overlaps.data() + overlaps.size());
+  }
+  for (std::uint64_t i = 0; i < buffer_.size(); i += detail::kParallelChunk) {
+    f(buffer_.data() + i,
+      buffer_.data() + std::min<std::uint64_t>(buffer_.size(),
+                                               i + detail::kParallelChunk));
+  }
+}
+
+void OverlapSpill::Read(std::uint64_t begin, std::vector<Record>& dst) const {
+  auto data = reinterpret_cast<char*>(dst.data());
+  std::uint64_t size = dst.size() * sizeof(Record);
+  for (std::uint64_t i = 0; i < size;) {
+    auto len = pread(fd_, data + i, size - i, begin * sizeof(Record) + i);
+    if (len <= 0) {
+      throw std::runtime_error(
+          "[raven::OverlapSpill::Read] error: unable to read spill file");
+    }
+    i += len;
+  }
+}
+
+void OverlapSpill::Write(std::uint64_t begin, const std::vector<Record>& src) {
+  auto data = reinterpret_cast<const char*>(src.data());
+  std::uint64_t size = src.size() * sizeof(Record);
+  for (std::uint64_t i = 0; i < size;) {
+    auto len = pwrite(fd_, data + i, size - i, begin * sizeof(Record) + i);
+    if (len < 0) {
+      throw std::runtime_error(
+          "[raven::OverlapSpill::Write] error: unable to write spill file");
+    }
+    i += len;
+  }
+}
+
+}  // namespace raven
@@ -0,0 +1,105 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_OVERLAP_SPILL_HPP_
+#define RAVEN_OVERLAP_SPILL_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "biosoup/overlap.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+namespace raven {
+
+// append-only list of overlaps which keeps at most max_bytes of them in memory
+// (0 for no limit) and writes the rest in runs to an unlinked file in dir;
+// overlaps are always visited in the order they were added, which keeps
+// results independent of the limit
+class OverlapSpill {
+ public:
+  OverlapSpill(std::string dir = ".", std::uint64_t max_bytes = 0);
+
+  OverlapSpill(const OverlapSpill&) = delete;
+  OverlapSpill& operator=(const OverlapSpill&) = delete;
+
+  ~OverlapSpill();
+
+  std::uint64_t size() const {
+    return num_spilled_ + buffer_.size();
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  std::uint64_t num_spilled() const {
+    return num_spilled_;
+  }
+
+  // last added overlap, never spilled
+  biosoup::Overlap& back() {
+    return buffer_.back();
+  }
+
+  void emplace_back(const biosoup::Overlap& o);
+
+  void ForEach(const std::function<void(const biosoup::Overlap&)>& f) const;
+
+  // calls f(id, o) for both reads id of every overlap o, reads [0, num_reads)
+  // are split into ranges and each range is visited by one task, so calls for
+  // the same read never run concurrently and follow the order of overlaps
+  void ForEachRead(
+      std::uint32_t num_reads,
+      const std::function<void(std::uint32_t, const biosoup::Overlap&)>& f,
+      std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr) const;
+
+  // keeps overlaps for which keep returns true, with positions as modified by
+  // keep; spilled overlaps are compacted in place; with thread_pool keep is
+  // called concurrently on slices of overlaps
+  void Filter(const std::function<bool(biosoup::Overlap&)>& keep,
+              std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+  void Clear();
+
+ private:
+  struct Record {
+    std::uint32_t lhs_id;
+    std::uint32_t lhs_begin;
+    std::uint32_t lhs_end;
+    std::uint32_t rhs_id;
+    std::uint32_t rhs_begin;
+    std::uint32_t rhs_end;
+    std::uint32_t score;
+    std::uint32_t strand;
+  };
+
+  static Record Pack(const biosoup::Overlap& o);
+
+  static biosoup::Overlap Unpack(const Record& r);
+
+  // writes all buffered overlaps but the last one
+  void Spill();
+
+  // calls f with consecutive runs of overlaps, spilled ones are read back
+  void ForEachRun(
+      const std::function<void(const biosoup::Overlap*,
+                               const biosoup::Overlap*)>& f) const;
+
+  // reads spilled overlaps [begin, begin + dst.size())
+  void Read(std::uint64_t begin, std::vector<Record>& dst) const;
+
+  void Write(std::uint64_t begin, const std::vector<Record>& src);
+
+  std::string dir_;
+  std::uint64_t max_bytes_;
+  int fd_;
+  std::uint64_t num_spilled_;
+  std::vector<biosoup::Overlap> buffer_;
+};
+
+}  // namespace raven
+
+#endif  // RAVEN_OVERLAP_SPILL_HPP_
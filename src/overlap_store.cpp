@@ -0,0 +1,239 @@
+#include "overlap_store.hpp"
+
+#include <algorithm>
+
+#include "common.hpp"
+
+namespace raven {
+
+namespace detail {
+
+std::uint32_t constexpr kStrandFlag = 1U << 31;
+std::uint32_t constexpr kReverseFlag = 1U << 30;
+std::uint32_t constexpr kSlotMask = kReverseFlag - 1;
+
+// marks the rhs side of a new overlap in its bucket
+std::uint64_t constexpr kRhsFlag = 1ULL << 63;
+
+}  // namespace detail
+
+const OverlapStore::Record& OverlapStore::record(
+    std::uint32_t id, const Entry& entry) const {
+  auto lhs_id = entry.slot & detail::kReverseFlag ? entry.id : id;
+  return records_[record_offsets_[lhs_id] + (entry.slot & detail::kSlotMask)];
+}
+
+OverlapStore::Record& OverlapStore::record(
+    std::uint32_t id, const Entry& entry) {
+  auto lhs_id = entry.slot & detail::kReverseFlag ? entry.id : id;
+  return records_[record_offsets_[lhs_id] + (entry.slot & detail::kSlotMask)];
+}
+
+biosoup::Overlap OverlapStore::Get(std::uint32_t id, std::uint32_t j) const {
+  const auto& entry = entries_[entry_offsets_[id] + j];
+  const auto& r = record(id, entry);
+  bool strand = entry.slot & detail::kStrandFlag;
+  if (entry.slot & detail::kReverseFlag) {
+    return biosoup::Overlap(id, r.rhs_begin, r.rhs_end, entry.id, r.lhs_begin,
+                            r.lhs_end, 0, strand);
+  }
+  return biosoup::Overlap(id, r.lhs_begin, r.lhs_end, entry.id, r.rhs_begin,
+                          r.rhs_end, 0, strand);
+}
+
+void OverlapStore::Set(std::uint32_t id, std::uint32_t j,
+                       const biosoup::Overlap& o) {
+  const auto& entry = entries_[entry_offsets_[id] + j];
+  auto& r = record(id, entry);
+  if (entry.slot & detail::kReverseFlag) {
+    r = Record{o.rhs_begin, o.rhs_end, o.lhs_begin, o.lhs_end};
+  } else {
+    r = Record{o.lhs_begin, o.lhs_end, o.rhs_begin, o.rhs_end};
+  }
+}
+
+std::vector<biosoup::Overlap> OverlapStore::Unpack(
+    std::uint32_t id, std::uint32_t begin) const {
+  std::vector<biosoup::Overlap> dst;
+  dst.reserve(sizes_[id] - std::min(begin, sizes_[id]));
+  for (auto j = begin; j < sizes_[id]; ++j) {
+    dst.emplace_back(Get(id, j));
+  }
+  return dst;
+}
+
+void OverlapStore::Assign(
+    const std::vector<std::vector<biosoup::Overlap>>& overlaps,
+    std::uint32_t num_reads,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  // reads are split into ranges, one per thread, and each range is handled by
+  // one task which writes only to data of its own reads
+  std::uint32_t num_ranges =
+      std::max<std::uint32_t>(1, thread_pool ? thread_pool->num_threads() : 1);
+  std::uint32_t range_len =
+      std::max<std::uint32_t>(1, (num_reads + num_ranges - 1) / num_ranges);
+  auto for_each_range = [&] (
+      const std::function<void(std::uint32_t, std::uint32_t, std::uint32_t)>&
+          f) -> void {
+    util::ParallelFor(thread_pool, num_ranges,
+        [&] (std::uint32_t begin, std::uint32_t end) -> void {
+          for (auto r = begin; r < end; ++r) {
+            f(r, std::min(num_reads, r * range_len),
+              std::min(num_reads, (r + 1) * range_len));
+          }
+        });
+  };
+
+  std::vector<std::uint64_t> firsts(1, 0);  // of overlaps in each batch
+  for (const auto& it : overlaps) {
+    firsts.emplace_back(firsts.back() + it.size());
+  }
+
+  // each worker takes a share of overlaps and buckets their sides by the
+  // range of the read they belong to, so that a range reads only its buckets;
+  // buckets keep the order of overlaps as workers take consecutive batches
+  std::vector<std::vector<NewSide>> buckets(num_ranges * num_ranges);
+  util::ParallelFor(thread_pool, num_ranges,
+      [&] (std::uint32_t begin, std::uint32_t end) -> void {
+        for (auto w = begin; w < end; ++w) {
+          auto first = std::lower_bound(firsts.begin(), firsts.end() - 1,
+              firsts.back() * w / num_ranges) - firsts.begin();
+          auto last = std::lower_bound(firsts.begin(), firsts.end() - 1,
+              firsts.back() * (w + 1) / num_ranges) - firsts.begin();
+          auto worker_buckets = buckets.begin() + w * num_ranges;
+          for (auto i = first; i < last; ++i) {
+            for (std::uint32_t j = 0; j < overlaps[i].size(); ++j) {
+              const auto& it = overlaps[i][j];
+              auto k = firsts[i] + j;
+              worker_buckets[it.lhs_id / range_len].emplace_back(
+                  NewSide{&it, k});
+              worker_buckets[it.rhs_id / range_len].emplace_back(
+                  NewSide{&it, k | detail::kRhsFlag});
+            }
+          }
+        }
+      });
+  auto for_each_side = [&] (std::uint32_t r,
+                            const std::function<void(const NewSide&)>& f)
+      -> void {
+    for (std::uint32_t w = 0; w < num_ranges; ++w) {
+      for (const auto& it : buckets[w * num_ranges + r]) {
+        f(it);
+      }
+    }
+  };
+
+  // count records and entries per read
+  std::vector<std::uint32_t> slots(firsts.back());
+  std::vector<std::uint64_t> record_offsets(num_reads + 1, 0);
+  std::vector<std::uint64_t> entry_offsets(num_reads + 1, 0);
+  for_each_range([&] (std::uint32_t r, std::uint32_t, std::uint32_t) -> void {
+    for_each_side(r, [&] (const NewSide& it) -> void {
+      if (it.k & detail::kRhsFlag) {
+        ++entry_offsets[it.overlap->rhs_id + 1];
+      } else {
+        slots[it.k] = record_offsets[it.overlap->lhs_id + 1]++;
+        ++entry_offsets[it.overlap->lhs_id + 1];
+      }
+    });
+  });
+  for (std::uint32_t i = 0; i < num_reads; ++i) {
+    record_offsets[i + 1] += record_offsets[i];
+    entry_offsets[i + 1] += entry_offsets[i];
+  }
+
+  // place records under lhs reads and entries under both reads
+  std::vector<Record> records(record_offsets.back());
+  std::vector<Entry> entries(entry_offsets.back());
+  std::vector<std::uint32_t> sizes(num_reads, 0);
+  for_each_range([&] (std::uint32_t r, std::uint32_t, std::uint32_t) -> void {
+    for_each_side(r, [&] (const NewSide& it) -> void {
+      const auto& o = *it.overlap;
+      auto slot = slots[it.k & ~detail::kRhsFlag] |
+                  (o.strand ? detail::kStrandFlag : 0);
+      if (it.k & detail::kRhsFlag) {
+        entries[entry_offsets[o.rhs_id] + sizes[o.rhs_id]++] =
+            Entry{o.lhs_id, slot | detail::kReverseFlag};
+      } else {
+        records[record_offsets[o.lhs_id] + (slot & detail::kSlotMask)] =
+            Record{o.lhs_begin, o.lhs_end, o.rhs_begin, o.rhs_end};
+        entries[entry_offsets[o.lhs_id] + sizes[o.lhs_id]++] =
+            Entry{o.rhs_id, slot};
+      }
+    });
+  });
+
+  records_.swap(records);
+  record_offsets_.swap(record_offsets);
+  entries_.swap(entries);
+  entry_offsets_.swap(entry_offsets);
+  sizes_.swap(sizes);
+}
+
+void OverlapStore::Assign(
+    std::uint32_t num_reads,
+    const std::function<std::uint32_t(std::uint32_t)>& size,
+    const std::function<std::vector<biosoup::Overlap>(std::uint32_t)>& row,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  std::vector<std::uint64_t> offsets(num_reads + 1, 0);
+  for (std::uint32_t i = 0; i < num_reads; ++i) {
+    offsets[i + 1] = offsets[i] + size(i);
+  }
+
+  std::vector<Record> records(offsets.back());
+  std::vector<Entry> entries(offsets.back());
+  std::vector<std::uint32_t> sizes(num_reads, 0);
+  util::ParallelFor(thread_pool, num_reads,
+      [&] (std::uint32_t begin, std::uint32_t end) -> void {
+        for (auto i = begin; i < end; ++i) {
+          for (const auto& it : row(i)) {
+            auto slot = sizes[i]++;
+            records[offsets[i] + slot] =
+                Record{it.lhs_begin, it.lhs_end, it.rhs_begin, it.rhs_end};
+            entries[offsets[i] + slot] =
+                Entry{it.rhs_id, slot | (it.strand ? detail::kStrandFlag : 0)};
+          }
+        }
+      });
+
+  records_.swap(records);
+  record_offsets_ = offsets;
+  entries_.swap(entries);
+  entry_offsets_.swap(offsets);
+  sizes_.swap(sizes);
+}
+
+void OverlapStore::Filter(
+    std::uint32_t id, const std::function<bool(biosoup::Overlap&)>& keep) {
+  auto first = entries_.begin() + entry_offsets_[id];
+  std::uint32_t k = 0;
+  for (std::uint32_t j = 0; j < sizes_[id]; ++j) {
+    auto o = Get(id, j);
+    if (keep(o)) {
+      Set(id, j, o);
+      first[k++] = first[j];
+    }
+  }
+  sizes_[id] = k;
+}
+
+void OverlapStore::Filter(
+    const std::function<bool(biosoup::Overlap&)>& keep,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  util::ParallelFor(thread_pool, num_reads(),
+      [&] (std::uint32_t begin, std::uint32_t end) -> void {
+        for (auto i = begin; i < end; ++i) {
+          Filter(i, keep);
+        }
+      });
+}
+
+void OverlapStore::Clear() {
+  std::vector<Record>().swap(records_);
+  std::vector<std::uint64_t>().swap(record_offsets_);
+  std::vector<Entry>().swap(entries_);
+  std::vector<std::uint64_t>().swap(entry_offsets_);
+  std::vector<std::uint32_t>().swap(sizes_);
+}
+
+}  // namespace raven
@@ -0,0 +1,126 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_OVERLAP_STORE_HPP_
+#define RAVEN_OVERLAP_STORE_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "biosoup/overlap.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+namespace raven {
+
+// overlaps indexed by read id in one contiguous buffer (CSR); an overlap is
+// stored once under its lhs read as 16 bytes of positions and referenced from
+// both of its reads, the rhs read sees it reversed; scores are not kept
+class OverlapStore {
+ public:
+  OverlapStore() = default;
+
+  OverlapStore(const OverlapStore&) = delete;
+  OverlapStore& operator=(const OverlapStore&) = delete;
+
+  OverlapStore(OverlapStore&&) = default;
+  OverlapStore& operator=(OverlapStore&&) = default;
+
+  ~OverlapStore() = default;
+
+  std::uint32_t num_reads() const {
+    return sizes_.size();
+  }
+
+  // number of overlaps of read id
+  std::uint32_t size(std::uint32_t id) const {
+    return sizes_[id];
+  }
+
+  // memory taken by the buffer
+  std::uint64_t bytes() const {
+    return records_.size() * sizeof(Record) + entries_.size() * sizeof(Entry) +
+           (record_offsets_.size() + entry_offsets_.size()) *
+               sizeof(std::uint64_t) +
+           sizes_.size() * sizeof(std::uint32_t);
+  }
+
+  // overlap j of read id, with id as lhs
+  biosoup::Overlap Get(std::uint32_t id, std::uint32_t j) const;
+
+  // stores positions of o as overlap j of read id
+  void Set(std::uint32_t id, std::uint32_t j, const biosoup::Overlap& o);
+
+  // overlaps [begin, size(id)) of read id
+  std::vector<biosoup::Overlap> Unpack(std::uint32_t id,
+                                       std::uint32_t begin = 0) const;
+
+  // replaces all overlaps with the given ones, which are added to both of
+  // their reads, in two passes counting and then placing them; with
+  // thread_pool overlaps are first bucketed by ranges of destination reads and
+  // both passes are split by these ranges
+  void Assign(const std::vector<std::vector<biosoup::Overlap>>& overlaps,
+              std::uint32_t num_reads,
+              std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+  // replaces all overlaps, read id gets the size(id) overlaps returned by
+  // row(id) (with id as lhs) which are not shared with other reads
+  void Assign(
+      std::uint32_t num_reads,
+      const std::function<std::uint32_t(std::uint32_t)>& size,
+      const std::function<std::vector<biosoup::Overlap>(std::uint32_t)>& row,
+      std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+  // keeps overlaps of read id for which keep returns true, with positions as
+  // modified by keep
+  void Filter(std::uint32_t id,
+              const std::function<bool(biosoup::Overlap&)>& keep);
+
+  // Filter of every read, with thread_pool reads are split into ranges and
+  // keep is called concurrently for different reads, so it must not modify
+  // overlaps shared by two reads (only those stored by Assign are not)
+  void Filter(const std::function<bool(biosoup::Overlap&)>& keep,
+              std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+  // drops overlaps of read id, the other reads still see them
+  void Clear(std::uint32_t id) {
+    sizes_[id] = 0;
+  }
+
+  void Clear();
+
+ private:
+  struct Record {
+    std::uint32_t lhs_begin;
+    std::uint32_t lhs_end;
+    std::uint32_t rhs_begin;
+    std::uint32_t rhs_end;
+  };
+
+  // reference to a record from one of its reads
+  struct Entry {
+    std::uint32_t id;    // the other read
+    std::uint32_t slot;  // among records of the lhs read, with strand and
+                         // reverse flags in the top bits
+  };
+
+  // side of an overlap bucketed by Assign
+  struct NewSide {
+    const biosoup::Overlap* overlap;
+    std::uint64_t k;  // among given overlaps, with the rhs flag in the top bit
+  };
+
+  const Record& record(std::uint32_t id, const Entry& entry) const;
+
+  Record& record(std::uint32_t id, const Entry& entry);
+
+  std::vector<Record> records_;
+  std::vector<std::uint64_t> record_offsets_;
+  std::vector<Entry> entries_;
+  std::vector<std::uint64_t> entry_offsets_;
+  std::vector<std::uint32_t> sizes_;  // entries in use
+};
+
+}  // namespace raven
+
+#endif  // RAVEN_OVERLAP_STORE_HPP_
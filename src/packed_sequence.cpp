@@ -0,0 +1,264 @@
+#include "packed_sequence.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "common.hpp"
+
+namespace raven {
+
+namespace detail {
+
+// 4 marks a base that is stored as N
+std::uint8_t EncodeBase(char c) {
+  switch (c) {
+    case 'A': case 'a': return 0;
+    case 'C': case 'c': return 1;
+    case 'G': case 'g': return 2;
+    case 'T': case 't': return 3;
+    default: return 4;
+  }
+}
+
+char constexpr kDecodeBase[] = "ACGT";
+
+}  // namespace detail
+
+PackedSequence::PackedSequence(const std::string& data)
+    : PackedSequence(data.c_str(), data.size()) {}
+
+PackedSequence::PackedSequence(const char* data, std::uint32_t data_len) {
+  words_.reserve((data_len + 31) >> 5);
+  for (std::uint32_t i = 0; i < data_len; ++i) {
+    if (data[i] == '\n' || data[i] == '\r' || data[i] == ' ' ||
+        data[i] == '\t') {
+      continue;
+    }
+    auto code = detail::EncodeBase(data[i]);
+    if (code > 3) {
+      PushN();
+    } else {
+      Push(code);
+    }
+  }
+}
+
+std::string PackedSequence::substr(std::uint32_t pos,
+                                   std::uint32_t len) const {
+  if (pos > size_) {
+    throw std::out_of_range("[raven::PackedSequence::substr] error: "
+                            "position out of range");
+  }
+  len = std::min(len, size_ - pos);
+
+  std::string dst(len, 'N');
+  for (std::uint32_t i = 0; i < len; ++i) {
+    dst[i] = detail::kDecodeBase[Code(pos + i)];
+  }
+
+  auto it = std::upper_bound(n_runs_.begin(), n_runs_.end(), pos,
+      [] (std::uint32_t p, const Run& r) -> bool {
+        return p < r.first + r.second;
+      });
+  for (; it != n_runs_.end() && it->first < pos + len; ++it) {
+    auto begin = std::max(it->first, pos);
+    auto end = std::min(it->first + it->second, pos + len);
+    std::fill(dst.begin() + (begin - pos), dst.begin() + (end - pos), 'N');
+  }
+
+  return dst;
+}
+
+void PackedSequence::Append(const PackedSequence& other, std::uint32_t pos,
+                            std::uint32_t len) {
+  if (pos > other.size_) {
+    throw std::out_of_range("[raven::PackedSequence::Append] error: "
+                            "position out of range");
+  }
+  len = std::min(len, other.size_ - pos);
+
+  auto offset = size_;
+  words_.reserve((size_ + len + 31) >> 5);
+  for (std::uint32_t i = pos; i < pos + len; ++i) {
+    Push(other.Code(i));
+  }
+
+  auto it = std::upper_bound(other.n_runs_.begin(), other.n_runs_.end(), pos,
+      [] (std::uint32_t p, const Run& r) -> bool {
+        return p < r.first + r.second;
+      });
+  for (; it != other.n_runs_.end() && it->first < pos + len; ++it) {
+    auto begin = offset + std::max(it->first, pos) - pos;
+    auto end = offset + std::min(it->first + it->second, pos + len) - pos;
+    if (!n_runs_.empty() &&
+        n_runs_.back().first + n_runs_.back().second == begin) {
+      n_runs_.back().second += end - begin;
+    } else {
+      n_runs_.emplace_back(begin, end - begin);
+    }
+  }
+}
+
+PackedSequence PackedSequence::ReverseComplement() const {
+  PackedSequence dst;
+  dst.words_.reserve(words_.size());
+  for (std::uint32_t i = size_; i > 0; --i) {
+    dst.Push(3 - Code(i - 1));
+  }
+  for (auto it = n_runs_.rbegin(); it != n_runs_.rend(); ++it) {
+    dst.n_runs_.emplace_back(size_ - it->first - it->second, it->second);
+  }
+  return dst;
+}
+
+void PackedSequence::Push(std::uint8_t code) {
+  if ((size_ & 31) == 0) {
+    words_.emplace_back(0);
+  }
+  words_.back() |= static_cast<std::uint64_t>(code) << ((size_ & 31) << 1);
+  ++size_;
+}
+
+void PackedSequence::PushN() {
+  if (!n_runs_.empty() &&
+      n_runs_.back().first + n_runs_.back().second == size_) {
+    ++n_runs_.back().second;
+  } else {
+    n_runs_.emplace_back(size_, 1);
+  }
+  Push(0);
+}
+
+void PackedSequences::Append(std::unique_ptr<biosoup::Sequence> header,
+                             PackedSequence bases, double mean_quality,
+                             SequenceOrigin origin, bool has_quality) {
+  header->id = bases_.size();
+  std::string().swap(header->data);
+  origin.length = bases.size();
+  headers_.emplace_back(std::move(header));
+  bases_.emplace_back(std::move(bases));
+  mean_qualities_.emplace_back(mean_quality);
+  has_qualities_.emplace_back(has_quality);
+  origins_.emplace_back(origin);
+}
+
+void PackedSequences::Append(PackedSequences&& other) {
+  headers_.reserve(headers_.size() + other.headers_.size());
+  bases_.reserve(bases_.size() + other.bases_.size());
+  mean_qualities_.reserve(mean_qualities_.size() + other.size());
+  has_qualities_.reserve(has_qualities_.size() + other.size());
+  origins_.reserve(origins_.size() + other.size());
+  for (std::uint32_t i = 0; i < other.size(); ++i) {
+    headers_.emplace_back(std::move(other.headers_[i]));
+    headers_.back()->id = bases_.size();
+    bases_.emplace_back(std::move(other.bases_[i]));
+    mean_qualities_.emplace_back(other.mean_qualities_[i]);
+    has_qualities_.emplace_back(other.has_qualities_[i]);
+    origins_.emplace_back(other.origins_[i]);
+  }
+  other = PackedSequences();
+}
+
+void PackedSequences::Append(PackedSequences&& other, std::uint32_t input) {
+  for (auto& it : other.origins_) {
+    it.input = input;
+  }
+  Append(std::move(other));
+}
+
+std::uint64_t PackedSequences::bytes() const {
+  std::uint64_t dst = 0;
+  for (std::uint32_t i = 0; i < size(); ++i) {
+    dst += bases_[i].bytes() + headers_[i]->name.size() +
+           headers_[i]->quality.size();
+  }
+  return dst;
+}
+
+void PackedSequences::Evict(std::uint32_t id) {
+  if (store_) {
+    bases_[id] = PackedSequence();
+  }
+}
+
+void PackedSequences::Fetch(const std::vector<std::uint32_t>& ids) {
+  std::vector<std::uint32_t> evicted;
+  for (const auto& it : ids) {
+    if (is_evicted(it)) {
+      evicted.emplace_back(it);
+    }
+  }
+  if (!evicted.empty()) {
+    store_->FetchBases(*this, evicted);
+  }
+}
+
+void PackedSequences::Fetch() {
+  std::vector<std::uint32_t> ids(size());
+  std::iota(ids.begin(), ids.end(), 0);
+  Fetch(ids);
+}
+
+std::unique_ptr<biosoup::Sequence> PackedSequences::Unpack(
+    std::uint32_t id) const {
+  // default constructed to keep biosoup::Sequence::num_objects intact
+  std::unique_ptr<biosoup::Sequence> dst(new biosoup::Sequence());
+  dst->id = id;
+  dst->name = headers_[id]->name;
+  dst->data = bases_[id].str();
+  dst->quality = headers_[id]->quality;
+  return dst;
+}
+
+std::vector<std::unique_ptr<biosoup::Sequence>> PackedSequences::Unpack(
+    std::uint32_t first, std::uint32_t last) const {
+  std::vector<std::unique_ptr<biosoup::Sequence>> dst;
+  dst.reserve(last - first);
+  for (std::uint32_t i = first; i < last; ++i) {
+    dst.emplace_back(Unpack(i));
+  }
+  return dst;
+}
+
+std::vector<std::unique_ptr<biosoup::Sequence>> PackedSequences::Unpack(
+    std::vector<std::uint32_t>::const_iterator first,
+    std::vector<std::uint32_t>::const_iterator last) const {
+  std::vector<std::unique_ptr<biosoup::Sequence>> dst;
+  dst.reserve(last - first);
+  for (auto it = first; it != last; ++it) {
+    dst.emplace_back(Unpack(*it));
+  }
+  return dst;
+}
+
+std::unique_ptr<biosoup::Sequence> PackedSequences::UnpackBases(
+    std::uint32_t id) const {
+  std::unique_ptr<biosoup::Sequence> dst(new biosoup::Sequence());
+  dst->id = id;
+  dst->data = bases_[id].str();
+  return dst;
+}
+
+std::vector<std::unique_ptr<biosoup::Sequence>> PackedSequences::UnpackBases(
+    std::uint32_t first, std::uint32_t last) const {
+  std::vector<std::unique_ptr<biosoup::Sequence>> dst;
+  dst.reserve(last - first);
+  for (std::uint32_t i = first; i < last; ++i) {
+    dst.emplace_back(UnpackBases(i));
+  }
+  return dst;
+}
+
+std::vector<std::unique_ptr<biosoup::Sequence>> PackedSequences::UnpackBases(
+    std::vector<std::uint32_t>::const_iterator first,
+    std::vector<std::uint32_t>::const_iterator last) const {
+  std::vector<std::unique_ptr<biosoup::Sequence>> dst;
+  dst.reserve(last - first);
+  for (auto it = first; it != last; ++it) {
+    dst.emplace_back(UnpackBases(*it));
+  }
+  return dst;
+}
+
+}  // namespace raven
@@ -0,0 +1,261 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_PACKED_SEQUENCE_HPP_
+#define RAVEN_PACKED_SEQUENCE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "biosoup/sequence.hpp"
+#include "cereal/access.hpp"
+#include "cereal/types/string.hpp"
+#include "cereal/types/utility.hpp"
+#include "cereal/types/vector.hpp"
+
+namespace raven {
+
+namespace util {
+
+class SequenceStore;
+
+}  // namespace util
+
+// nucleotides packed 2 bits per base, bases other than ACGT are stored as
+// runs on the side and decoded as N
+class PackedSequence {
+ public:
+  PackedSequence() = default;
+
+  explicit PackedSequence(const std::string& data);
+
+  // whitespace in data is skipped
+  PackedSequence(const char* data, std::uint32_t data_len);
+
+  std::uint32_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  // memory taken by the packed bases
+  std::uint64_t bytes() const {
+    return words_.size() * sizeof(std::uint64_t) + n_runs_.size() * sizeof(Run);
+  }
+
+  // decode len bases starting at pos
+  std::string substr(std::uint32_t pos = 0,
+                     std::uint32_t len = static_cast<std::uint32_t>(-1)) const;
+
+  std::string str() const {
+    return substr();
+  }
+
+  // append len bases of other starting at pos without decoding them
+  void Append(const PackedSequence& other, std::uint32_t pos = 0,
+              std::uint32_t len = static_cast<std::uint32_t>(-1));
+
+  PackedSequence ReverseComplement() const;
+
+ private:
+  friend cereal::access;
+
+  template <class Archive>
+  void serialize(Archive& archive) {  // NOLINT
+    archive(size_, words_, n_runs_);
+  }
+
+  using Run = std::pair<std::uint32_t, std::uint32_t>;  // begin, length
+
+  std::uint8_t Code(std::uint32_t i) const {
+    return (words_[i >> 5] >> ((i & 31) << 1)) & 3;
+  }
+
+  void Push(std::uint8_t code);
+
+  void PushN();
+
+  std::uint32_t size_ = 0;
+  std::vector<std::uint64_t> words_;
+  std::vector<Run> n_runs_;
+};
+
+// index entry of a read, locates its record in the inputs
+struct SequenceOrigin {
+  template <class Archive>
+  void serialize(Archive& archive) {  // NOLINT
+    archive(input, length, offset);
+  }
+
+  std::uint32_t input;
+  std::uint32_t length;  // number of bases
+  std::uint64_t offset;  // of the record in the (inflated) input
+};
+
+// read set with bases held as PackedSequence and indexed by sequence id;
+// names and qualities are kept as parsed, qualities may be dropped and loaded
+// back later as the mean quality of each read is kept aside; with a store
+// attached bases can be evicted and fetched back from the inputs
+class PackedSequences {
+ public:
+  PackedSequences() = default;
+
+  PackedSequences(const PackedSequences&) = delete;
+  PackedSequences& operator=(const PackedSequences&) = delete;
+
+  PackedSequences(PackedSequences&&) = default;
+  PackedSequences& operator=(PackedSequences&&) = default;
+
+  ~PackedSequences() = default;
+
+  std::uint32_t size() const {
+    return bases_.size();
+  }
+
+  bool empty() const {
+    return bases_.empty();
+  }
+
+  // memory taken by packed bases (none while evicted), names and qualities
+  std::uint64_t bytes() const;
+
+  std::uint32_t length(std::uint32_t id) const {
+    return origins_[id].length;
+  }
+
+  const std::string& name(std::uint32_t id) const {
+    return headers_[id]->name;
+  }
+
+  // empty while evicted
+  const PackedSequence& bases(std::uint32_t id) const {
+    return bases_[id];
+  }
+
+  void set_bases(std::uint32_t id, PackedSequence bases) {
+    bases_[id] = std::move(bases);
+  }
+
+  bool is_evicted(std::uint32_t id) const {
+    return bases_[id].size() != origins_[id].length;
+  }
+
+  void set_store(std::shared_ptr<util::SequenceStore> store) {
+    store_ = std::move(store);
+  }
+
+  const std::string& quality(std::uint32_t id) const {
+    return headers_[id]->quality;
+  }
+
+  void set_quality(std::uint32_t id, std::string quality) {
+    headers_[id]->quality = std::move(quality);
+  }
+
+  // mean phred score, 0 for FASTA reads
+  double mean_quality(std::uint32_t id) const {
+    return mean_qualities_[id];
+  }
+
+  // true for FASTQ reads, even while their qualities are deferred
+  bool has_quality(std::uint32_t id) const {
+    return has_qualities_[id];
+  }
+
+  const SequenceOrigin& origin(std::uint32_t id) const {
+    return origins_[id];
+  }
+
+  // header holds name and quality (empty if deferred), its id is set to the
+  // next free one; has_quality marks reads parsed with qualities
+  void Append(std::unique_ptr<biosoup::Sequence> header, PackedSequence bases,
+              double mean_quality = 0.,
+              SequenceOrigin origin = SequenceOrigin(),
+              bool has_quality = false);
+
+  // takes over other, continuing the stored ids
+  void Append(PackedSequences&& other);
+
+  // takes over other whose reads all come from input
+  void Append(PackedSequences&& other, std::uint32_t input);
+
+  // drops bases of id, kept if there is no store to fetch them back from
+  void Evict(std::uint32_t id);
+
+  // brings back bases of evicted sequences among ids
+  void Fetch(const std::vector<std::uint32_t>& ids);
+
+  // brings back all evicted bases
+  void Fetch();
+
+  // decoded copy with the original id, name and quality
+  std::unique_ptr<biosoup::Sequence> Unpack(std::uint32_t id) const;
+
+  // decoded copies of sequences [first, last)
+  std::vector<std::unique_ptr<biosoup::Sequence>> Unpack(
+      std::uint32_t first, std::uint32_t last) const;
+
+  // decoded copies of sequences with given ids
+  std::vector<std::unique_ptr<biosoup::Sequence>> Unpack(
+      std::vector<std::uint32_t>::const_iterator first,
+      std::vector<std::uint32_t>::const_iterator last) const;
+
+  // decoded copy with the original id and bases only, enough for the
+  // minimizer engine which never reads names and qualities
+  std::unique_ptr<biosoup::Sequence> UnpackBases(std::uint32_t id) const;
+
+  // decoded bases of sequences [first, last)
+  std::vector<std::unique_ptr<biosoup::Sequence>> UnpackBases(
+      std::uint32_t first, std::uint32_t last) const;
+
+  // decoded bases of sequences with given ids
+  std::vector<std::unique_ptr<biosoup::Sequence>> UnpackBases(
+      std::vector<std::uint32_t>::const_iterator first,
+      std::vector<std::uint32_t>::const_iterator last) const;
+
+ private:
+  friend cereal::access;
+
+  // index only, bases and qualities are left out so loaded sequences are all
+  // evicted and their qualities deferred
+  template <class Archive>
+  void save(Archive& archive) const {  // NOLINT
+    std::vector<std::string> names;
+    names.reserve(headers_.size());
+    for (const auto& it : headers_) {
+      names.emplace_back(it->name);
+    }
+    archive(names, mean_qualities_, has_qualities_, origins_);
+  }
+
+  template <class Archive>
+  void load(Archive& archive) {  // NOLINT
+    std::vector<std::string> names;
+    archive(names, mean_qualities_, has_qualities_, origins_);
+
+    headers_.clear();
+    headers_.reserve(names.size());
+    for (auto& it : names) {
+      std::unique_ptr<biosoup::Sequence> header(new biosoup::Sequence());
+      header->id = headers_.size();
+      header->name = std::move(it);
+      headers_.emplace_back(std::move(header));
+    }
+    bases_.assign(headers_.size(), PackedSequence());
+  }
+
+  std::vector<std::unique_ptr<biosoup::Sequence>> headers_;  // without data
+  std::vector<PackedSequence> bases_;
+  std::vector<float> mean_qualities_;
+  std::vector<bool> has_qualities_;
+  std::vector<SequenceOrigin> origins_;
+  std::shared_ptr<util::SequenceStore> store_;
+};
+
+}  // namespace raven
+
+#endif  // RAVEN_PACKED_SEQUENCE_HPP_
@@ -0,0 +1,326 @@
+#include "parser.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace raven {
+namespace util {
+
+namespace detail {
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsSuffix(const std::string& s, const std::string& suff) {
+  return s.size() < suff.size()
+             ? false
+             : s.compare(s.size() - suff.size(), suff.size(), suff) == 0;
+}
+
+enum class Record { kValid, kIncomplete, kInvalid };
+
+std::uint64_t LineEnd(const char* data, std::uint64_t size,
+                      std::uint64_t pos) {
+  auto it = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+  return it ? it - data : size;
+}
+
+void ParseName(const char* data, std::uint64_t eol, std::uint64_t pos,
+               SequenceView& view) {
+  auto name_end = pos + 1;
+  while (name_end < eol && !IsSpace(data[name_end])) {
+    ++name_end;
+  }
+  view.name = data + pos + 1;
+  view.name_len = name_end - pos - 1;
+}
+
+Record ParseFasta(const char* data, std::uint64_t size, bool is_last,
+                  std::uint64_t& pos, SequenceView& view) {
+  auto eol = LineEnd(data, size, pos);
+  ParseName(data, eol, pos, view);
+
+  auto begin = std::min(eol + 1, size);
+  auto end = begin;
+  while (end < size && data[end] != '>') {
+    end = std::min(LineEnd(data, size, end) + 1, size);
+  }
+  if (end == size && !is_last) {  // next record not reached yet
+    return Record::kIncomplete;
+  }
+
+  view.data = data + begin;
+  view.data_len = end - begin;
+  view.quality = nullptr;
+  view.quality_len = 0;
+
+  pos = end;
+  return Record::kValid;
+}
+
+Record ParseFastq(const char* data, std::uint64_t size, bool is_last,
+                  std::uint64_t& pos, SequenceView& view) {
+  auto line_len = [&] (std::uint64_t begin, std::uint64_t end) -> std::uint64_t {  // NOLINT
+    return end - begin - (end > begin && data[end - 1] == '\r');
+  };
+  auto truncated = is_last ? Record::kInvalid : Record::kIncomplete;
+
+  auto eol = LineEnd(data, size, pos);
+  ParseName(data, eol, pos, view);
+
+  std::uint64_t num_bases = 0;
+  auto begin = std::min(eol + 1, size);
+  auto end = begin;
+  while (end < size && data[end] != '+') {
+    eol = LineEnd(data, size, end);
+    num_bases += line_len(end, eol);
+    end = std::min(eol + 1, size);
+  }
+  if (end == size) {
+    return truncated;
+  }
+
+  std::uint64_t num_qualities = 0;
+  auto quality_begin = std::min(LineEnd(data, size, end) + 1, size);
+  auto quality_end = quality_begin;
+  while (quality_end < size && num_qualities < num_bases) {
+    eol = LineEnd(data, size, quality_end);
+    num_qualities += line_len(quality_end, eol);
+    quality_end = std::min(eol + 1, size);
+  }
+  if (num_qualities < num_bases || (eol == size && !is_last)) {
+    return truncated;
+  }
+  if (num_qualities != num_bases) {
+    return Record::kInvalid;
+  }
+
+  view.data = data + begin;
+  view.data_len = end - begin;
+  view.quality = data + quality_begin;
+  view.quality_len = quality_end - quality_begin;
+
+  pos = quality_end;
+  return Record::kValid;
+}
+
+// offset is the input offset of data
+std::vector<SequenceView> ParseRecords(
+    const char* data, std::uint64_t size, bool is_last, std::uint64_t bytes,
+    std::uint64_t offset, std::uint64_t& pos, const std::string& path) {
+  std::vector<SequenceView> dst;
+
+  auto begin = pos;
+  while (pos < size && pos - begin < bytes) {
+    if (IsSpace(data[pos])) {
+      ++pos;
+      continue;
+    }
+
+    SequenceView view;
+    view.input = 0;
+    view.offset = offset + pos;
+    auto record = Record::kInvalid;
+    if (data[pos] == '>') {
+      record = ParseFasta(data, size, is_last, pos, view);
+    } else if (data[pos] == '@') {
+      record = ParseFastq(data, size, is_last, pos, view);
+    }
+    if (record == Record::kIncomplete) {
+      break;
+    }
+    if (record == Record::kInvalid) {
+      throw std::invalid_argument(
+          "[raven::util::SequenceParser::Parse] error: invalid file format " +
+          path);
+    }
+
+    dst.emplace_back(view);
+  }
+
+  return dst;
+}
+
+}  // namespace detail
+
+std::string StripLineBreaks(const char* src, std::uint32_t len) {
+  std::string dst;
+  dst.reserve(len);
+  for (std::uint32_t i = 0; i < len; ++i) {
+    if (src[i] != '\n' && src[i] != '\r') {
+      dst += src[i];
+    }
+  }
+  return dst;
+}
+
+double MeanQuality(const char* src, std::uint32_t len) {
+  std::uint64_t sum = 0;
+  std::uint32_t num_qualities = 0;
+  for (std::uint32_t i = 0; i < len; ++i) {
+    if (src[i] != '\n' && src[i] != '\r') {
+      sum += src[i] - 33;
+      ++num_qualities;
+    }
+  }
+  return num_qualities ? static_cast<double>(sum) / num_qualities : 0.;
+}
+
+MappedParser::MappedParser(const std::string& path)
+    : data_(nullptr), size_(0), pos_(0), path_(path) {
+  auto fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::invalid_argument(
+        "[raven::util::MappedParser] error: unable to open file " + path);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    throw std::invalid_argument(
+        "[raven::util::MappedParser] error: unable to stat file " + path);
+  }
+
+  size_ = st.st_size;
+  if (size_ > 0) {
+    auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw std::invalid_argument(
+          "[raven::util::MappedParser] error: unable to map file " + path);
+    }
+    madvise(data, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+  }
+  close(fd);  // mapping stays valid
+}
+
+MappedParser::~MappedParser() {
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+std::vector<SequenceView> MappedParser::Parse(std::uint64_t bytes) {
+  return detail::ParseRecords(data_, size_, true, bytes, 0, pos_, path_);
+}
+
+bool MappedParser::Seek(std::uint64_t offset) {
+  if (offset > size_) {
+    throw std::out_of_range(
+        "[raven::util::MappedParser::Seek] error: offset out of range " +
+        path_);
+  }
+  pos_ = offset;
+  return true;
+}
+
+StreamParser::StreamParser(
+    const std::string& path,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool)
+    : decompressor_(path, thread_pool),
+      buffer_(),
+      begin_(0),
+      pos_(0),
+      is_eof_(false),
+      path_(path) {}
+
+std::vector<SequenceView> StreamParser::Parse(std::uint64_t bytes) {
+  if (!is_eof_ && buffer_.size() - pos_ < bytes) {
+    buffer_.erase(0, pos_);  // records handed out by previous calls
+    begin_ += pos_;
+    pos_ = 0;
+    while (!is_eof_ && buffer_.size() < bytes) {
+      Fill();
+    }
+  }
+  while (true) {  // views are taken only once buffer_ stops growing
+    auto dst = detail::ParseRecords(
+        buffer_.data(), buffer_.size(), is_eof_, bytes, begin_, pos_, path_);
+    if (!dst.empty() || is_eof_) {
+      return dst;
+    }
+    Fill();
+  }
+}
+
+void StreamParser::Fill() {
+  auto chunk = decompressor_.Next();
+  if (chunk.empty()) {
+    is_eof_ = true;
+  } else {
+    buffer_ += chunk;
+  }
+}
+
+ChainParser::ChainParser(
+    std::vector<std::unique_ptr<SequenceParser>> parsers)
+    : parsers_(std::move(parsers)), current_(0) {}
+
+std::vector<SequenceView> ChainParser::Parse(std::uint64_t bytes) {
+  for (; current_ < parsers_.size(); ++current_) {
+    auto dst = parsers_[current_]->Parse(bytes);
+    if (!dst.empty()) {
+      for (auto& it : dst) {
+        it.input = current_;
+      }
+      return dst;
+    }
+  }
+  return std::vector<SequenceView>();
+}
+
+std::unique_ptr<SequenceParser> CreateParser(
+    const std::string& path,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  using detail::IsSuffix;
+
+  try {
+    if (path == "-") {
+      return std::unique_ptr<SequenceParser>(
+          new StreamParser(path, thread_pool));
+    }
+    if (IsSuffix(path, ".fasta") || IsSuffix(path, ".fa") ||
+        IsSuffix(path, ".fastq") || IsSuffix(path, ".fq")) {
+      return std::unique_ptr<SequenceParser>(new MappedParser(path));
+    }
+    if (IsSuffix(path, ".fasta.gz") || IsSuffix(path, ".fa.gz") ||
+        IsSuffix(path, ".fastq.gz") || IsSuffix(path, ".fq.gz")) {
+      return std::unique_ptr<SequenceParser>(
+          new StreamParser(path, thread_pool));
+    }
+  } catch (const std::invalid_argument& exception) {
+    std::cerr << exception.what() << std::endl;
+    return nullptr;
+  }
+
+  std::cerr << "[raven::CreateParser] error: file " << path
+            << " has unsupported format extension (valid extensions: .fasta, "
+            << ".fasta.gz, .fa, .fa.gz, .fastq, .fastq.gz, .fq, .fq.gz; - for "
+            << "stdin)" << std::endl;
+  return nullptr;
+}
+
+std::unique_ptr<SequenceParser> CreateParser(
+    const std::vector<std::string>& paths,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool) {
+  std::vector<std::unique_ptr<SequenceParser>> parsers;
+  for (const auto& it : paths) {
+    parsers.emplace_back(CreateParser(it, thread_pool));
+    if (parsers.back() == nullptr) {
+      return nullptr;
+    }
+  }
+  return std::unique_ptr<SequenceParser>(new ChainParser(std::move(parsers)));
+}
+
+}  // namespace util
+}  // namespace raven
@@ -0,0 +1,122 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_PARSER_HPP_
+#define RAVEN_PARSER_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "decompressor.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+namespace raven {
+namespace util {
+
+// FASTA/FASTQ record pointing into memory owned by the parser, valid until
+// the next call to Parse; data and quality may span several lines and still
+// contain line breaks, name is already shortened to its first word
+struct SequenceView {
+  const char* name;
+  std::uint32_t name_len;
+  const char* data;
+  std::uint32_t data_len;
+  const char* quality;  // nullptr for FASTA
+  std::uint32_t quality_len;
+  std::uint32_t input;    // index among chained inputs
+  std::uint64_t offset;   // of the record in the (inflated) input
+};
+
+// copy of a view field without line breaks
+std::string StripLineBreaks(const char* src, std::uint32_t len);
+
+// mean phred score of a view quality field
+double MeanQuality(const char* src, std::uint32_t len);
+
+class SequenceParser {
+ public:
+  virtual ~SequenceParser() = default;
+
+  // parses records from at least bytes of input (or until its end),
+  // empty once the input is exhausted
+  virtual std::vector<SequenceView> Parse(std::uint64_t bytes) = 0;
+
+  // moves to the record at offset, false if the input is not seekable
+  virtual bool Seek(std::uint64_t offset) {
+    (void) offset;
+    return false;
+  }
+};
+
+// memory maps an uncompressed FASTA/FASTQ file and hands out views into the
+// mapping, the page cache is shared with other processes reading the file
+class MappedParser : public SequenceParser {
+ public:
+  explicit MappedParser(const std::string& path);
+
+  MappedParser(const MappedParser&) = delete;
+  MappedParser& operator=(const MappedParser&) = delete;
+
+  ~MappedParser() override;
+
+  std::vector<SequenceView> Parse(std::uint64_t bytes) override;
+
+  bool Seek(std::uint64_t offset) override;
+
+ private:
+  const char* data_;
+  std::uint64_t size_;
+  std::uint64_t pos_;
+  std::string path_;
+};
+
+// parses FASTA/FASTQ read through a Decompressor (gzip inflated on the thread
+// pool, plain text or stdin passed through), views point into the text kept
+// since the last call
+class StreamParser : public SequenceParser {
+ public:
+  StreamParser(const std::string& path,
+               std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+  std::vector<SequenceView> Parse(std::uint64_t bytes) override;
+
+ private:
+  // appends the next inflated chunk to buffer_
+  void Fill();
+
+  Decompressor decompressor_;
+  std::string buffer_;
+  std::uint64_t begin_;  // input offset of buffer_
+  std::uint64_t pos_;
+  bool is_eof_;
+  std::string path_;
+};
+
+// parses several inputs one after another
+class ChainParser : public SequenceParser {
+ public:
+  explicit ChainParser(std::vector<std::unique_ptr<SequenceParser>> parsers);
+
+  std::vector<SequenceView> Parse(std::uint64_t bytes) override;
+
+ private:
+  std::vector<std::unique_ptr<SequenceParser>> parsers_;
+  std::size_t current_;
+};
+
+// picks a parser from the file extension, "-" reads from stdin, returns nullptr on failure;
+// compressed inputs are inflated on thread_pool if one is given
+std::unique_ptr<SequenceParser> CreateParser(
+    const std::string& path,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+// chains parsers of all paths in order, returns nullptr if any one fails
+std::unique_ptr<SequenceParser> CreateParser(
+    const std::vector<std::string>& paths,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr);
+
+}  // namespace util
+}  // namespace raven
+
+#endif  // RAVEN_PARSER_HPP_
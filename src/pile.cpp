@@ -52,6 +52,23 @@ void Pile::AddLayers(
   }
 }
 
+void Pile::AddLayer(const biosoup::Overlap& o) {
+  std::uint32_t begin;
+  std::uint32_t end;
+  if (o.lhs_id == id_) {
+    begin = (o.lhs_begin >> kPSS) + 1;
+    end = (o.lhs_end >> kPSS) - 1;
+  } else if (o.rhs_id == id_) {
+    begin = (o.rhs_begin >> kPSS) + 1;
+    end = (o.rhs_end >> kPSS) - 1;
+  } else {
+    return;
+  }
+  for (std::uint32_t i = begin; i < end; ++i) {
+    ++data_[i];
+  }
+}
+
 void Pile::FindValidRegion(std::uint32_t coverage) {
   std::uint32_t begin = 0;
   std::uint32_t end = 0;
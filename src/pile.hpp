@@ -90,6 +90,9 @@ class Pile {
       std::vector<biosoup::Overlap>::const_iterator begin,
       std::vector<biosoup::Overlap>::const_iterator end);
 
+  // add coverage of a single overlap, same as AddLayers on it alone
+  void AddLayer(const biosoup::Overlap& o);
+
   // store longest region with values greater or equal than given coverage
   void FindValidRegion(std::uint32_t coverage);
 
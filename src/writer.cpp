@@ -0,0 +1,136 @@
+#include "writer.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace raven {
+namespace util {
+
+namespace detail {
+
+// upper bound of records formatted by one task
+std::size_t constexpr kWriteBlockLim = 1ULL << 16;
+
+bool IsCompressedPath(const std::string& path) {
+  return path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0;
+}
+
+// deflates src into a gzip member
+std::string Deflate(const std::string& src) {
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error(
+        "[raven::util::Writer] error: unable to initialize zlib");
+  }
+
+  std::string dst(deflateBound(&zs, src.size()), '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(src.data()));
+  zs.avail_in = src.size();
+  zs.next_out = reinterpret_cast<Bytef*>(&dst[0]);
+  zs.avail_out = dst.size();
+
+  auto ret = deflate(&zs, Z_FINISH);
+  dst.resize(zs.total_out);
+  deflateEnd(&zs);
+
+  if (ret != Z_STREAM_END) {
+    throw std::runtime_error(
+        "[raven::util::Writer] error: unable to compress output");
+  }
+  return dst;
+}
+
+}  // namespace detail
+
+Writer::Writer(
+    const std::string& path,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+    bool compress)
+    : fd_(path == "-" ? STDOUT_FILENO
+                      : open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+      compress_(compress || detail::IsCompressedPath(path)),
+      thread_pool_(thread_pool),
+      path_(path) {
+  if (fd_ == -1) {
+    throw std::invalid_argument(
+        "[raven::util::Writer] error: unable to open file " + path);
+  }
+}
+
+Writer::~Writer() {
+  if (fd_ != STDOUT_FILENO) {
+    close(fd_);
+  }
+}
+
+void Writer::Write(
+    std::size_t num_records,
+    const std::function<void(std::size_t, std::string&)>& format) {
+  std::size_t num_threads = thread_pool_ ? thread_pool_->num_threads() : 1;
+  std::size_t block_size = std::min(
+      detail::kWriteBlockLim,
+      std::max<std::size_t>(1, num_records / (8 * num_threads)));
+
+  auto format_block = [&] (std::size_t begin) -> std::string {
+    std::string dst;
+    for (auto i = begin; i < std::min(begin + block_size, num_records); ++i) {
+      format(i, dst);
+    }
+    return compress_ ? detail::Deflate(dst) : dst;
+  };
+
+  // bounded number of blocks in flight, the oldest one is written first
+  std::deque<std::future<std::string>> futures;
+  for (std::size_t i = 0; i < num_records; i += block_size) {
+    futures.emplace_back(thread_pool_
+        ? thread_pool_->Submit(format_block, i)
+        : std::async(std::launch::deferred, format_block, i));
+    if (futures.size() > 2 * num_threads) {
+      Flush(futures.front().get());
+      futures.pop_front();
+    }
+  }
+  for (auto& it : futures) {
+    Flush(it.get());
+  }
+}
+
+void Writer::Flush(const std::string& buffer) {
+  for (std::size_t i = 0; i < buffer.size();) {
+    auto len = write(fd_, buffer.data() + i, buffer.size() - i);
+    if (len < 0) {
+      throw std::runtime_error(
+          "[raven::util::Writer::Flush] error: unable to write " + path_);
+    }
+    i += len;
+  }
+}
+
+void AppendFasta(const std::string& name, const std::string& data,
+                 std::uint32_t line_width, std::string& dst) {
+  dst += '>';
+  dst += name;
+  dst += '\n';
+  if (line_width == 0) {
+    dst += data;
+    dst += '\n';
+    return;
+  }
+  for (std::size_t i = 0; i < data.size(); i += line_width) {
+    dst.append(data, i, line_width);
+    dst += '\n';
+  }
+}
+
+}  // namespace util
+}  // namespace raven
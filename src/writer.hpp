@@ -0,0 +1,54 @@
+// author tbrekalo 2020
+
+#ifndef RAVEN_WRITER_HPP_
+#define RAVEN_WRITER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "thread_pool/thread_pool.hpp"
+
+namespace raven {
+namespace util {
+
+// writes records to a file ("-" is stdout); records are formatted in blocks
+// on the thread pool into large buffers, compressed there into independent
+// gzip members if requested (or if path ends with .gz), and appended in order
+// by the calling thread while the following blocks are being formatted
+class Writer {
+ public:
+  Writer(const std::string& path,
+         std::shared_ptr<thread_pool::ThreadPool> thread_pool = nullptr,
+         bool compress = false);
+
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  ~Writer();
+
+  // appends format(i, dst) for records i in [0, num_records), format is
+  // called concurrently and must only append to dst
+  void Write(std::size_t num_records,
+             const std::function<void(std::size_t, std::string&)>& format);
+
+ private:
+  void Flush(const std::string& buffer);
+
+  int fd_;
+  bool compress_;
+  std::shared_ptr<thread_pool::ThreadPool> thread_pool_;
+  std::string path_;
+};
+
+// appends a FASTA record, data is wrapped every line_width bases (0 for a
+// single line)
+void AppendFasta(const std::string& name, const std::string& data,
+                 std::uint32_t line_width, std::string& dst);
+
+}  // namespace util
+}  // namespace raven
+
+#endif  // RAVEN_WRITER_HPP_